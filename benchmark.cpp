@@ -0,0 +1,355 @@
+// Host benchmarks for the keyer core on the native HAL (hal_native.cpp).
+// Reports, as one JSON object per line on stdout:
+//   loop        loop() pass time while idle and while keying
+//   decode      decodeAndPrintCharacter() and table lookup cost for every symbol (ns only)
+//   update_wpm  updateWPM() cost with no conversion, an unchanged and a new reading
+//   jitter      element on/off length error at every speed the keyer accepts
+//   instances   KeyerState/DecoderState step cost with many students side by side
+// Host times ("ns") are measured with CLOCK_MONOTONIC and only compare runs
+// on the same machine. "cycles" are the modelled ATmega328P cycles of the
+// HAL calls made (see the cost model in hal_native.cpp); they are exact
+// for a given build and do not depend on the host. For the jitter runs every
+// loop() pass takes its modelled HAL cycles plus --core-cycles (default
+// 300) for the core's own work, at 16 MHz.
+//
+// Built as cwbench by CMakeLists.txt; run on a Linux host:
+//   build/cwbench [--core-cycles N] > results.jsonl
+
+#if !defined(ARDUINO)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include "hal.h"
+#include "keyer.h"
+#include "morse_encode.h"
+
+// --- Core internals exercised directly ---
+extern DecoderState decoder;
+void decodeAndPrintCharacter();
+void handleStamps();
+void updateWPM();
+
+// =========================================================================
+// BENCHMARK CONFIGURATION
+// =========================================================================
+const unsigned long F_CPU_HZ = 16000000UL;
+unsigned long coreCycles = 300;            // Modelled cost of the core's own work per pass
+const int LOOP_SAMPLES = 20000;
+const int DECODE_REPEATS = 2000;
+const int JITTER_ELEMENTS = 40;            // Elements measured per paddle and speed
+const uint64_t SETTLE_MICROS = 2000000ULL; // Longer than WORD_GAP at 5 WPM
+const int STUDENTS = 1000;                 // Independent keyers in the "instances" run
+const unsigned long STUDENT_TICK = 100;    // Virtual microseconds between student steps
+const unsigned long STUDENT_RUN = 10000000UL;
+
+// --- Symbols decoded by the "decode" benchmark, in MORSE_ALPHABET order ---
+const char* BENCH_SYMBOLS = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+uint64_t cycleCarry = 0;                   // Cycles not yet turned into whole microseconds
+char outputBuffer[512];
+
+uint64_t hostNanos() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * @brief Advances the virtual clock by a modelled number of AVR cycles.
+ */
+void spendCycles(uint64_t cycles) {
+  cycleCarry += cycles * 1000000ULL;
+  unsigned long micros = (unsigned long)(cycleCarry / F_CPU_HZ);
+  cycleCarry -= (uint64_t)micros * F_CPU_HZ;
+  if (micros > 0) halNativeAdvance(micros);
+}
+
+/**
+ * @brief Runs one loop() pass; stores its host time and modelled cycles
+ *        and moves the virtual clock on by what the pass would take.
+ */
+void timedPass(uint64_t* nanos, uint64_t* cycles) {
+  uint64_t cyclesBefore = halNativeCycles();
+  uint64_t started = hostNanos();
+  loop();
+  uint64_t elapsed = hostNanos() - started;
+  uint64_t used = halNativeCycles() - cyclesBefore;
+  if (nanos != NULL) *nanos = elapsed;
+  if (cycles != NULL) *cycles = used;
+  spendCycles(used + coreCycles);
+}
+
+void drainOutput() {
+  while (halNativeTakeOutput(outputBuffer, sizeof(outputBuffer)) > 0) {
+  }
+}
+
+/**
+ * @brief Runs the keyer with released paddles long enough for the last
+ *        character and word gap to pass even at the lowest speed.
+ */
+void settle() {
+  uint64_t until = halNativeTime() + SETTLE_MICROS;
+  while (halNativeTime() < until) timedPass(NULL, NULL);
+  drainOutput();
+}
+
+/**
+ * @brief Sends a command line and runs the keyer until it is applied.
+ *        Returns true when the device answered "OK".
+ */
+bool sendCommand(const char* line) {
+  drainOutput();
+  halNativeReceive(line);
+  halNativeReceive("\r");
+  for (int i = 0; i < 2000; i++) timedPass(NULL, NULL);
+  halNativeTakeOutput(outputBuffer, sizeof(outputBuffer));
+  bool ok = strncmp(outputBuffer, "OK", 2) == 0;
+  settle();
+  return ok;
+}
+
+uint64_t percentile(std::vector<uint64_t>& samples, int percent) {
+  if (samples.empty()) return 0;
+  std::sort(samples.begin(), samples.end());
+  size_t index = (samples.size() - 1) * percent / 100;
+  return samples[index];
+}
+
+void printDistribution(const char* unit, std::vector<uint64_t>& samples) {
+  printf("\"%s\":{\"min\":%llu,\"p50\":%llu,\"p99\":%llu,\"max\":%llu}", unit,
+         (unsigned long long)percentile(samples, 0), (unsigned long long)percentile(samples, 50),
+         (unsigned long long)percentile(samples, 99), (unsigned long long)percentile(samples, 100));
+}
+
+// =========================================================================
+// BENCHMARKS
+// =========================================================================
+
+/**
+ * @brief loop() pass time with the paddles released and with one held.
+ */
+void benchLoop(const char* state, uint8_t keys) {
+  std::vector<uint64_t> nanos(LOOP_SAMPLES), cycles(LOOP_SAMPLES);
+  halNativeSetKeys(keys);
+  for (int i = 0; i < LOOP_SAMPLES; i++) {
+    timedPass(&nanos[i], &cycles[i]);
+    if ((i & 63) == 0) drainOutput();
+  }
+  halNativeSetKeys(0);
+  settle();
+
+  printf("{\"bench\":\"loop\",\"state\":\"%s\",\"passes\":%d,", state, LOOP_SAMPLES);
+  printDistribution("ns", nanos);
+  printf(",");
+  printDistribution("cycles", cycles);
+  printf("}\n");
+}
+
+/**
+ * @brief Cost of decoding each symbol, plus an unknown sequence ('?'):
+ *        decodeAndPrintCharacter() timed call by call, and the table
+ *        lookup alone (DecoderState::take(), which scans MORSE_ALPHABET
+ *        in order, then the punctuation codes) averaged over a batch, where the clock read would
+ *        otherwise swamp it. Host time only: the lookup makes no HAL
+ *        calls, so modelled cycles would not tell the symbols apart.
+ */
+void benchDecode() {
+  for (int symbol = 0; symbol <= 36; symbol++) {
+    const char* pattern = (symbol < 36) ? MORSE_ALPHABET[symbol] : "......-";
+    std::vector<uint64_t> nanos(DECODE_REPEATS);
+    for (int i = 0; i < DECODE_REPEATS; i++) {
+      for (const char* p = pattern; *p; p++) decoder.append(*p);
+      uint64_t started = hostNanos();
+      decodeAndPrintCharacter();
+      nanos[i] = hostNanos() - started;
+      handleStamps();
+      drainOutput();
+    }
+
+    DecoderState lookup;
+    lookup.reset();
+    volatile char sink = 0;
+    uint64_t started = hostNanos();
+    for (int i = 0; i < DECODE_REPEATS; i++) {
+      for (const char* p = pattern; *p; p++) lookup.append(*p);
+      sink = lookup.take();
+    }
+    uint64_t lookupNanos = (hostNanos() - started) / DECODE_REPEATS;
+    (void)sink;
+
+    printf("{\"bench\":\"decode\",\"symbol\":\"%c\",\"pattern\":\"%s\",\"ns_p50\":%llu,\"ns_max\":%llu,\"lookup_ns\":%llu}\n",
+           (symbol < 36) ? BENCH_SYMBOLS[symbol] : '?', pattern, (unsigned long long)percentile(nanos, 50),
+           (unsigned long long)percentile(nanos, 100), (unsigned long long)lookupNanos);
+  }
+}
+
+/**
+ * @brief updateWPM() while the ADC is busy, with the same reading and with
+ *        a reading that changes the speed.
+ */
+void benchUpdateWPM() {
+  const char* cases[] = { "busy", "unchanged", "changed" };
+  for (int c = 0; c < 3; c++) {
+    std::vector<uint64_t> nanos(DECODE_REPEATS);
+    uint64_t cycles = 0;
+    for (int i = 0; i < DECODE_REPEATS; i++) {
+      if (c > 0) halNativeAdvance(200); // Conversion finished
+      if (c == 2) halNativeSetPot((i & 1) ? 100 : 900);
+      uint64_t cyclesBefore = halNativeCycles();
+      uint64_t started = hostNanos();
+      updateWPM();
+      nanos[i] = hostNanos() - started;
+      cycles = halNativeCycles() - cyclesBefore;
+      drainOutput();
+    }
+    printf("{\"bench\":\"update_wpm\",\"case\":\"%s\",\"ns_p50\":%llu,\"cycles\":%llu}\n",
+           cases[c], (unsigned long long)percentile(nanos, 50), (unsigned long long)cycles);
+  }
+  halNativeSetPot(300);
+  settle();
+}
+
+/**
+ * @brief Holds one paddle and compares every on and off period with the
+ *        ideal element and element-gap length at this speed.
+ */
+void benchJitter(int wpm, uint8_t paddle) {
+  double dot = 1200000.0 / wpm;
+  double onIdeal = (paddle == KEY_DASH) ? 3 * dot : dot;
+  double offIdeal = dot;
+  double onSum = 0, offSum = 0, onMax = 0, offMax = 0;
+  int onCount = 0, offCount = 0;
+
+  halNativeSetKeys(paddle);
+  bool key = halNativeKeyOutput();
+  uint64_t lastEdge = 0;
+  bool haveEdge = false;
+  while (onCount < JITTER_ELEMENTS) {
+    uint64_t passStart = halNativeTime();
+    timedPass(NULL, NULL);
+    if (halNativeKeyOutput() == key) continue;
+    key = !key;
+    if (haveEdge) {
+      double error = (double)(passStart - lastEdge) - (key ? offIdeal : onIdeal);
+      double size = error < 0 ? -error : error;
+      if (key) {
+        offSum += error;
+        if (size > offMax) offMax = size;
+        offCount++;
+      } else {
+        onSum += error;
+        if (size > onMax) onMax = size;
+        onCount++;
+      }
+    }
+    lastEdge = passStart;
+    haveEdge = true;
+    drainOutput();
+  }
+  halNativeSetKeys(0);
+  settle();
+
+  printf("{\"bench\":\"jitter\",\"wpm\":%d,\"element\":\"%s\",\"elements\":%d,"
+         "\"stop_mean_us\":%.1f,\"stop_max_us\":%.1f,\"start_mean_us\":%.1f,\"start_max_us\":%.1f}\n",
+         wpm, (paddle == KEY_DASH) ? "dash" : "dot", onCount,
+         onSum / onCount, onMax, offCount ? offSum / offCount : 0.0, offMax);
+}
+
+/**
+ * @brief Steps many independent keyers and decoders in one process, each
+ *        at its own speed with random paddle presses, and reports the
+ *        host cost of one student step.
+ */
+void benchInstances() {
+  struct Student {
+    KeyerState keyer;
+    DecoderState decoder;
+    unsigned long dot;
+    unsigned long nextInput;
+    uint8_t paddles;
+  };
+  std::vector<Student> students(STUDENTS);
+  uint32_t random = 12345;
+  for (int i = 0; i < STUDENTS; i++) {
+    students[i].keyer.reset(0);
+    students[i].decoder.reset();
+    students[i].dot = 1200000UL / (5 + i % 36);
+    students[i].nextInput = 0;
+    students[i].paddles = 0;
+  }
+
+  unsigned long symbols = 0;
+  uint64_t started = hostNanos();
+  for (unsigned long now = 0; now < STUDENT_RUN; now += STUDENT_TICK) {
+    for (int i = 0; i < STUDENTS; i++) {
+      Student& student = students[i];
+      if ((long)(now - student.nextInput) >= 0) {
+        random = random * 1664525UL + 1013904223UL;
+        student.paddles = (random >> 24) & 3;
+        student.nextInput = now + student.dot * (1 + ((random >> 20) & 3));
+      }
+      if (student.keyer.elementDue(now)) {
+        student.keyer.stopElement(now);
+        student.decoder.keyUp(now, student.keyer.characterTime);
+      }
+      if (!student.keyer.isKeying && student.decoder.poll(now, 7 * student.dot) != '\0') symbols++;
+      char element = student.keyer.iambicNext<IambicBPolicy>(now, student.paddles & KEY_DOT, student.paddles & KEY_DASH, false);
+      if (element != '\0') {
+        student.decoder.append(element);
+        student.keyer.startElement(now, element, element == '-' ? 3 * student.dot : student.dot, student.dot, 3 * student.dot);
+      }
+    }
+  }
+  uint64_t elapsed = hostNanos() - started;
+  unsigned long steps = STUDENT_RUN / STUDENT_TICK * STUDENTS;
+
+  printf("{\"bench\":\"instances\",\"students\":%d,\"bytes_each\":%u,\"steps\":%lu,"
+         "\"symbols\":%lu,\"ns_per_step\":%.1f}\n",
+         STUDENTS, (unsigned)(sizeof(KeyerState) + sizeof(DecoderState)), steps, symbols,
+         (double)elapsed / steps);
+}
+
+// =========================================================================
+// MAIN
+// =========================================================================
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--core-cycles") == 0 && i + 1 < argc) {
+      coreCycles = strtoul(argv[++i], NULL, 10);
+    } else {
+      fprintf(stderr, "usage: %s [--core-cycles N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  halNativeReset();
+  halNativeSetPot(300);
+  setup();
+  drainOutput();
+  printf("{\"bench\":\"meta\",\"f_cpu\":%lu,\"core_cycles\":%lu}\n", F_CPU_HZ, coreCycles);
+
+  sendCommand("MODE IAMBIC_B");
+  benchLoop("idle", 0);
+  benchLoop("keying", KEY_DOT);
+  benchDecode();
+  benchUpdateWPM();
+  benchInstances();
+
+  // Every speed the WPM command accepts
+  for (int wpm = 1; wpm <= 200; wpm++) {
+    char line[16];
+    snprintf(line, sizeof(line), "WPM %d", wpm);
+    if (!sendCommand(line)) continue;
+    benchJitter(wpm, KEY_DOT);
+    benchJitter(wpm, KEY_DASH);
+  }
+  return 0;
+}
+
+#endif // !ARDUINO
@@ -0,0 +1,191 @@
+// Character error rate check for perfect keying on a Linux host.
+// Keys a pangram with every letter and digit at each speed from CER_MIN_WPM
+// to CER_MAX_WPM into the keyer core on the native HAL (hal_native.cpp).
+// The input is the one the core is built for:
+// paddles (IAMBIC_MODE 1, Iambic Mode B, each element started by a
+// half-dot press once the previous gap has run out) or the straight key
+// (each element held for exactly its length, every gap exact). The speed
+// is set with the pot before boot. Each run starts from a fresh boot
+// (halNativeReset()); loop() runs every LOOP_MICROS of virtual time, and the
+// clock never steps past an input change, so every press and release is
+// seen at its exact time. The decoded text is compared with what was
+// keyed and the character error rate (edit distance / characters keyed)
+// is printed per speed, word spaces included; the exit status is 1 if any
+// character is wrong.
+//
+// Built as cwcer_paddle and cwcer_straight by CMakeLists.txt, each on a
+// core with HIGH_SPEED_MODE 1, and run by ctest; on its own:
+//   build/cwcer_paddle [--loop-us N]
+
+#if !defined(ARDUINO)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "hal.h"
+#include "host_harness.h"
+
+// =========================================================================
+// CER CONFIGURATION
+// =========================================================================
+const int CER_MIN_WPM = 5;               // MIN_WPM of the sketch
+const int CER_MAX_WPM = 80;              // MAX_WPM with HIGH_SPEED_MODE 1
+const char* const CER_TEXT = "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG 0123456789";
+const unsigned long START_MS = 100;      // Keying starts this long after boot
+unsigned long loopMicros = 20;           // Virtual cost of one loop() pass
+
+const char* const CER_ALPHABET[] = {
+  ".-", "-...", "-.-.", "-..", ".", "..-.", "--.", "....", "..", ".---",
+  "-.-", ".-..", "--", "-.", "---", ".--.", "--.-", ".-.", "...", "-",
+  "..-", "...-", ".--", "-..-", "-.--", "--..",
+  "-----", ".----", "..---", "...--", "....-", ".....", "-....", "--...",
+  "---..", "----."
+};
+
+#if IAMBIC_MODE
+const char* const INPUT_NAME = "paddle";
+#else
+const char* const INPUT_NAME = "straight";
+#endif
+
+// =========================================================================
+// EXECUTION
+// =========================================================================
+
+struct KeyChange {
+  uint64_t time;   // Virtual microseconds
+  uint8_t keys;    // KEY_* bits closed from then on
+};
+
+/**
+ * @brief Contact changes that key CER_TEXT at wpm, starting at START_MS.
+ */
+std::vector<KeyChange> keyText(int wpm) {
+  std::vector<KeyChange> changes;
+  uint64_t dot = 1200000ULL / wpm;
+  uint64_t time = START_MS * 1000ULL;
+  for (const char* text = CER_TEXT; *text; text++) {
+    if (*text == ' ') {
+      time += 4 * dot; // Character gap already elapsed: 3 + 4 = 7 dots
+      continue;
+    }
+    int index = (*text >= 'A' && *text <= 'Z') ? *text - 'A' : 26 + *text - '0';
+    for (const char* pattern = CER_ALPHABET[index]; *pattern; pattern++) {
+      uint64_t length = (*pattern == '-') ? 3 * dot : dot;
+      if (IAMBIC_MODE) {
+        KeyChange press = { time, (*pattern == '-') ? KEY_DASH : KEY_DOT };
+        KeyChange release = { time + dot / 2, 0 };
+        changes.push_back(press);
+        changes.push_back(release);
+      } else {
+        KeyChange press = { time, KEY_STRAIGHT };
+        KeyChange release = { time + length, 0 };
+        changes.push_back(press);
+        changes.push_back(release);
+      }
+      time += length + dot;
+    }
+    time += 2 * dot;
+  }
+  return changes;
+}
+
+/**
+ * @brief Lowest pot reading the core maps to wpm (potToWPM()).
+ */
+int potFor(int wpm) {
+  int pot = 0;
+  while (pot < 1023 && CER_MIN_WPM + (long)pot * (CER_MAX_WPM - CER_MIN_WPM) / 1023 < wpm) pot++;
+  return pot;
+}
+
+/**
+ * @brief Boots the core at wpm, keys CER_TEXT and returns everything
+ *        decoded.
+ */
+std::string runCase(int wpm) {
+  std::vector<KeyChange> changes = keyText(wpm);
+  uint64_t end = changes.back().time + 8 * (1200000ULL / wpm);
+
+  halNativeReset();
+  halNativeSetPot(potFor(wpm));
+  setup();
+  drainOutput();
+  std::string decoded;
+  size_t next = 0;
+  for (uint64_t now = 0; now < end;) {
+    for (; next < changes.size() && changes[next].time <= now; next++) halNativeSetKeys(changes[next].keys);
+    loop();
+    decoded += drainOutput();
+
+    uint64_t wake = now + loopMicros;
+    if (next < changes.size() && changes[next].time < wake) wake = changes[next].time;
+    halNativeAdvance((unsigned long)(wake - now));
+    now = wake;
+  }
+  return decoded;
+}
+
+/**
+ * @brief Drops the word space printed once keying stops; it ends the text
+ *        rather than separating two words.
+ */
+std::string withoutTrailingSpace(const std::string& text) {
+  if (!text.empty() && text[text.size() - 1] == ' ') return text.substr(0, text.size() - 1);
+  return text;
+}
+
+/**
+ * @brief Levenshtein distance: characters substituted, dropped or added.
+ */
+size_t editDistance(const std::string& a, const std::string& b) {
+  std::vector<size_t> row(b.size() + 1);
+  for (size_t j = 0; j <= b.size(); j++) row[j] = j;
+  for (size_t i = 1; i <= a.size(); i++) {
+    size_t diagonal = row[0];
+    row[0] = i;
+    for (size_t j = 1; j <= b.size(); j++) {
+      size_t above = row[j];
+      size_t cost = diagonal + (a[i - 1] == b[j - 1] ? 0 : 1);
+      if (above + 1 < cost) cost = above + 1;
+      if (row[j - 1] + 1 < cost) cost = row[j - 1] + 1;
+      row[j] = cost;
+      diagonal = above;
+    }
+  }
+  return row[b.size()];
+}
+
+// =========================================================================
+// MAIN
+// =========================================================================
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--loop-us") == 0 && i + 1 < argc) {
+      loopMicros = strtoul(argv[++i], NULL, 10);
+      if (loopMicros == 0) loopMicros = 1;
+    } else {
+      fprintf(stderr, "usage: %s [--loop-us N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  std::string expected = CER_TEXT;
+  int failures = 0;
+  for (int wpm = CER_MIN_WPM; wpm <= CER_MAX_WPM; wpm++) {
+    std::string decoded = runCase(wpm);
+    size_t errors = editDistance(expected, withoutTrailingSpace(decoded));
+    if (errors > 0) failures++;
+    printf("%s %-8s %2d WPM  CER %5.1f%%", errors ? "FAIL" : "PASS", INPUT_NAME, wpm,
+           100.0 * errors / expected.size());
+    if (errors) printf("  \"%s\"", decoded.c_str());
+    printf("\n");
+  }
+  printf("%d of %d runs had character errors\n", failures, CER_MAX_WPM - CER_MIN_WPM + 1);
+  return failures ? 1 : 0;
+}
+
+#endif // !ARDUINO
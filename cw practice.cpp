@@ -2,140 +2,293 @@
 // This version uses a POTENTIOMETER (A0) for variable WPM speed 
 // and outputs decoded characters to the Serial Monitor.
 
-#include <Arduino.h>  // Includes core Arduino definitions (String, pinMode, etc.)
+// All hardware access goes through hal.h (pins, clocks, sidetone, ADC,
+// UART), so the same file also builds on a Linux host with hal_native.cpp.
+
 #include <string.h>   // Required for strcmp()
+#include "hal.h"      // Pin definitions and the hardware abstraction layer
+#include "keyer.h"    // KeyerState / DecoderState
+#include "morse_encode.h" // Morse table, packed element codes, MORSE_MESSAGE
 
 // =========================================================================
 // !!! KEYER CONFIGURATION SWITCH !!!
 // Set to 1 to activate the mode, 0 to disable. 
-// Only ONE mode should be 1 at any time.
+// Set both to 1 to have the paddles and the straight key live at once;
+// whichever is used owns the sidetone (see INPUT DETECTION).
+// These are the power-on defaults; "MODE ..." over serial changes them
+// at runtime (see HOST COMMANDS), MODE AUTO being both at 1.
 // =========================================================================
+#ifndef IAMBIC_MODE
 #define IAMBIC_MODE      0
+#endif
+#ifndef STRAIGHT_KEY_MODE
 #define STRAIGHT_KEY_MODE 1 
+#endif
+#define PADDLE_IAMBIC_A     0 // Curtis Mode A
+#define PADDLE_IAMBIC_B     1 // Curtis Mode B (squeeze memory)
+#define PADDLE_ULTIMATIC    2 // The paddle pressed last wins a squeeze
+#define PADDLE_SINGLE_LEVER 3 // Squeezes ignored
+#define PADDLE_BUG          4 // Automatic dots, dash paddle keyed by hand
+#define PADDLE_COOTIE       5 // Sideswiper: both paddles keyed by hand
+#define PADDLE_MODE      PADDLE_IAMBIC_B // Paddle keying style (same order as KeyerMode)
+#define DOT_MEMORY       1 // 1 = a dot tapped during a dash is sent next
+#define DASH_MEMORY      1 // 1 = a dash tapped during a dot is sent next
+#define AUTOSPACE        0 // 1 = a paddle pause of an element gap ends the character
+
+// =========================================================================
+// !!! KEYER DISPATCH SWITCH !!!
+// 0 = only the style selected above is built, inlined into loop();
+//     "MODE ..." is answered with ERR.
+// 1 = every keying style is built in and "MODE ..." switches between
+//     them. The style is chosen once per character: when a mode change
+//     is applied (at a character boundary) its policy is copied into
+//     ActiveStyle, and loop() calls the one ActiveStyle pass directly,
+//     reading those fields instead of constants (see KEYER PASS).
+// =========================================================================
+#ifndef KEYER_RUNTIME_MODES
+#define KEYER_RUNTIME_MODES 0
+#endif
+
+// =========================================================================
+// !!! HIGH-SPEED MODE SWITCH !!!
+// Set to 1 to raise MAX_WPM from 40 to 80 for contest-speed practice.
+// Timing is scheduled in microseconds in both settings; this switch only
+// widens the range covered by the potentiometer. The host build also
+// compiles a high-speed sketch for the error-rate check (CMakeLists.txt).
+// =========================================================================
+#ifndef HIGH_SPEED_MODE
+#define HIGH_SPEED_MODE  0
+#endif
+
+// =========================================================================
+// !!! BEACON MODE SWITCH !!!
+// 0 = normal keyer/decoder. BEACON_QRSS sends BEACON_MESSAGE forever as
+// very slow on/off keyed CW; BEACON_DFCW sends dots and dashes of equal
+// length and tells them apart by a sidetone frequency shift.
+// Paddles and straight key are ignored while a beacon mode is active.
+// =========================================================================
+#define BEACON_QRSS      1
+#define BEACON_DFCW      2
+#ifndef BEACON_MODE
+#define BEACON_MODE      0
+#endif
 
-// --- Keyer Mode Configuration ---
-enum KeyerMode {
-  MODE_A, // Iambic Mode A (No Squeeze Memory)
-  MODE_B  // Iambic Mode B (Squeeze Memory)
+// --- Keyer Mode Configuration (KeyerMode: see keyer.h) ---
+KeyerMode currentIambicMode = (KeyerMode)PADDLE_MODE;
+// Indexed by KeyerMode: "MODE ..." argument and banner description
+const char* const PADDLE_MODE_NAMES[] = { "IAMBIC_A", "IAMBIC_B", "ULTIMATIC", "SINGLE_LEVER", "BUG", "COOTIE" };
+const char* const PADDLE_MODE_TITLES[] = {
+  "Mode A (No Memory)", "Mode B (Squeeze Memory)", "Ultimatic", "Single Lever", "Bug (Semi-Automatic)", "Cootie (Sideswiper)"
 };
-KeyerMode currentIambicMode = MODE_// =========================================================================
+const uint8_t PADDLE_MODE_COUNT = 6;
+bool iambicModeActive = IAMBIC_MODE == 1;
+bool straightKeyModeActive = STRAIGHT_KEY_MODE == 1;
+
+// =========================================================================
 // WPM SPEED CONTROL CONFIGURATION (VARIABLE SPEED)
 // =========================================================================
-const int POT_PIN = A0;      // Analog pin for WPM Potentiometer
 int currentWPM = 15;         // Starting WPM
 const int MIN_WPM = 5;       // Minimum allowed WPM
-const int MAX_WPM = 40;      // Maximum allowed WPM
+const int MAX_WPM = HIGH_SPEED_MODE ? 80 : 40; // Maximum allowed WPM
 const int TONE_FREQ = 650; // Frequency of the tone in Hertz.
+const int MIN_TONE_FREQ = 200;
+const int MAX_TONE_FREQ = 2000;
+unsigned int toneFrequency = TONE_FREQ; // Current sidetone, changed by "TONE"
+bool speedFromCommand = false;          // "WPM n" / "FARNS" override the potentiometer
+int farnsworthWPM = 0;                  // Effective (spacing) speed; 0 = Farnsworth off
+const int POT_HYSTERESIS = 4; // ADC counts the pot must move before the speed changes
 
-// --- Morse Code Timing Parameters (now dynamic global variables) ---
-// These are updated continuously by updateWPM()
-unsigned int DOT_DURATION = 1200 / currentWPM; // Duration of a dot in milliseconds
-unsigned int DASH_DURATION = 3 * DOT_DURATION;
-unsigned int ELEMENT_GAP = DOT_DURATION; // Gap between elements 
-unsigned int CHARACTER_GAP = 3 * DOT_DURATION; // Gap between characters 
-unsigned int WORD_GAP = 7 * DOT_DURATION;      // Gap between words 
-
-// --- Universal Pin Definitions ---
-const int LED_PIN = 13;   // Digital pin for the LED.
-const int BUZZER_PIN = 8; // Digital pin for the buzzer/speaker.
-
-// --- Universal State Variables ---
-unsigned long keyReleaseTime = 0;    // Time of the last transmitted element's release or tone stop
-String morseSequence = "";           // Stores the sequence of dots and dashes for a letter.
+// --- Beacon Configuration (BEACON_MODE only) ---
+constexpr char BEACON_MESSAGE[] = "VVV DE TEST"; // Repeated forever; letters, digits, punctuation and spaces
+const unsigned long QRSS_DOT_MS = 3000;      // QRSS3 .. QRSS60 -> 3000 .. 60000 ms
+const unsigned int DFCW_SHIFT_HZ = 5;        // Dash frequency offset (Timer2 steps are ~3 Hz at 650 Hz)
 
 // =========================================================================
-// Iambic Keyer Variables & Pin Definitions
+// SERIAL OUTPUT CONFIGURATION
 // =========================================================================
-const int DOT_PIN = 2;    // Digital pin for the DOT paddle (connect to GND)
-const int DASH_PIN = 3;   // Digital pin for the DASH paddle (connect to GND)
+// All output goes through an SRAM ring drained by the USART data-register-
+// empty interrupt, so a slow or absent host can never stall the keyer.
+// When the ring is full the overflow policy decides what is lost:
+#define TX_DROP_NEWEST     0 // Bytes that do not fit are discarded
+#define TX_DROP_OLDEST     1 // The oldest unsent bytes are overwritten
+#define TX_COALESCE_STATUS 2 // Like TX_DROP_NEWEST for text, but status lines
+                             // (speed reports) wait in a one-line slot where a
+                             // newer status replaces an older unsent one
+#ifndef TX_OVERFLOW_POLICY
+#define TX_OVERFLOW_POLICY TX_COALESCE_STATUS
+#endif
+const unsigned long SAFE_BAUD = 9600;         // Rate used at reset and after a failed switch
+const unsigned long BAUD_CONFIRM_MS = 2000;   // Time the host has to confirm a new rate
+const uint8_t BAUD_FALLBACK_ERRORS = 8;       // Consecutive framing errors that force SAFE_BAUD
+const int TX_RING_SIZE = 256;      // Must stay 256: indices wrap as uint8_t
+const int RX_RING_SIZE = 64;       // Power of two
+const int STATUS_LINE_SIZE = 48;
+const int COMMAND_LINE_SIZE = 32;
 
-// Iambic State Variables
-bool dotPaddleState = false;
-bool dashPaddleState = false;
-bool isKeying = false;               
-bool iambicBuffer = false;           
-unsigned long elementStopTime = 0;   
-unsigned long nextElementTime = 0;   
+// --- Host Text Sending / WinKeyer ---
+const int SEND_QUEUE_SIZE = 64;      // Power of two; characters waiting to be keyed
+const unsigned long WINKEYER_BAUD = 1200;
+const uint8_t WINKEYER_VERSION = 23; // Reported on host open (WK2.3)
+// Set to 1 to boot speaking the WinKeyer host protocol at WINKEYER_BAUD;
+// otherwise the "WK" command switches over at runtime.
+#define WINKEYER_DEFAULT 0
+bool winkeyerMode = WINKEYER_DEFAULT;
 
+// --- Message Memories (EEPROM, see MESSAGE MEMORIES) ---
+const uint16_t EEPROM_SETTINGS_SIZE = 64;    // Reserved at address 0 for saved settings
+const uint8_t MEMORY_COUNT = 6;
+const uint16_t MEMORY_SIZE = 160;            // Bytes per message: 640 symbols
+const unsigned long MEMORY_BUTTON_DEBOUNCE_MS = 20;
+const unsigned long MEMORY_BUTTON_SELECT_MS = 600; // Pause that ends a run of presses
+
+// --- Binary Telemetry ---
+// Set to 1 to start in telemetry mode; "TLM ON" / "TLM OFF" switch at runtime.
+#define TELEMETRY_DEFAULT 0
+
+// --- Loop Profiler ---
+// Set to 1 to time each loop() phase in CPU cycles (Timer1) and report
+// min/avg/max per phase with "PROF". At 0 the PROFILE_* macros expand to
+// nothing and the profiler costs neither flash, SRAM nor cycles.
+#define PROFILE_ENABLED 0
+
+// --- Morse Code Timing Parameters (now dynamic global variables) ---
+// These are updated continuously by updateWPM().
+// All durations are in MICROSECONDS: at 45 WPM a dot is 26.67 ms, which
+// millisecond timing would truncate by 2.5%.
+unsigned long DOT_DURATION = 1200000UL / currentWPM; // Duration of a dot
+unsigned long DASH_DURATION = 3 * DOT_DURATION;
+unsigned long ELEMENT_GAP = DOT_DURATION; // Gap between elements 
+unsigned long CHARACTER_GAP = 3 * DOT_DURATION; // Gap between characters 
+unsigned long WORD_GAP = 7 * DOT_DURATION;      // Gap between words 
+
+// --- Universal State Variables ---
+int lastPotReading = -POT_HYSTERESIS - 1; // ADC value that set currentWPM
 
 // =========================================================================
-// Straight Key Variables & Pin Definitions
+// Keyer and Decoder State (types: see keyer.h, pins: see hal.h)
 // =========================================================================
-const int STRAIGHT_KEY_PIN = 4; // Digital pin connected to the straight key (connect to GND) 
+// Paddles, straight key and send queue all drive this one keyer, and the
+// decoder echoes whatever it sends.
+KeyerState keyer;
+DecoderState decoder;
 
-// Straight Key State Variables
-unsigned long keyPressStartTime = 0;
-bool keyWasPressed = false;
 
-
-// --- Morse Code Lookup Table ---
-const char* MORSE_ALPHABET[] = {
-  ".-", "-...", "-.-.", "-..", ".", "..-.", "--.", "....", "..", ".---",
-  "-.-", ".-..", "--", "-.", "---", ".--.", "--.-", ".-.", "...", "-",
-  "..-", "...-", ".--", "-..-", "-.--", "--..",
-  "-----", ".----", "..---", "...--", "....-", ".....", "-....", "--...",
-  "---..", "----."
-};
+// Morse code table and packed element codes: see morse_encode.h
 
 // --- Function Prototypes ---
-void startElement(unsigned int duration, char element);
-void sendDot();
-void sendDash();
+void startElement(unsigned long duration, char element);
 void handleKeyerOutput();
 void handleKeyPress();
 void handleKeyRelease();
 void updateWPM(); // New function prototype
+void applyPotReading(int sensorValue);
+void setSpeed(int wpm);
+void handleWinkeyerByte(uint8_t data);
+void winkeyerReportPot();
+bool winkeyerActive();
 
 // =========================================================================
-// WPM Update Function
+// TIMING HELPERS
 // =========================================================================
+
 /**
- * @brief Reads the analog input and recalculates all Morse timing variables.
+ * @brief Wrap-safe deadline check. halMicros() wraps every ~71 minutes, so a
+ *        plain `now >= deadline` comparison would stall the keyer at the wrap.
  */
-void updateWPM() {
-  // Read the potentiometer value (0 to 1023)
-  int sensorValue = analogRead(POT_PIN);
-
-  // Map the sensor value to the WPM range (MIN_WPM to MAX_WPM)
-  int newWPM = map(sensorValue, 0, 1023, MIN_WPM, MAX_WPM);
-  
-  // Only update if the speed has changed
-  if (newWPM != currentWPM) {
-    currentWPM = newWPM;
-
-    // Recalculate all timing variables based on the new WPM
-    DOT_DURATION = 1200 / currentWPM; 
-    DASH_DURATION = 3 * DOT_DURATION;
-    ELEMENT_GAP = DOT_DURATION; 
-    CHARACTER_GAP = 3 * DOT_DURATION; 
-    WORD_GAP = 7 * DOT_DURATION;
-    
-    // Output the new speed to the Serial Monitor
-    Serial.print("\nSpeed: ");
-    Serial.print(currentWPM);
-    Serial.print(" WPM | Dot: ");
-    Serial.print(DOT_DURATION);
-    Serial.println("ms");
-  }
+inline bool timeReached(unsigned long now, unsigned long deadline) {
+  return (long)(now - deadline) >= 0;
 }
 
 // =========================================================================
-// UNIVERSAL HELPER FUNCTIONS
+// KEYER AND DECODER STATE
 // =========================================================================
+// Pure logic behind keyer.h: no HAL calls and no globals, so the glue in
+// the sections below decides what a change means for the sidetone, the
+// telemetry and the serial output.
+
+// Packed codes of A-Z and 0-9 (MORSE_ALPHABET order) and of
+// MORSE_PUNCTUATION, built by the compiler
+MORSE_MESSAGE(MORSE_CHARACTER_CODES, "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789");
+MORSE_MESSAGE(MORSE_PUNCTUATION_CODES, MORSE_PUNCTUATION);
+
+void KeyerState::reset(unsigned long now) {
+  elementStopTime = now;
+  nextElementTime = now;
+  keyReleaseTime = now;
+  keyPressStartTime = now;
+  isKeying = false;
+  keyWasPressed = false;
+  squeezeMemory = false;
+  memoryArmed = 0;
+  paddleMemory = 0;
+  paddlesClosed = 0;
+  lastPressed = '.';
+  gapScheduled = false;
+  keyingElement = '.';
+}
+
+void KeyerState::startElement(unsigned long now, char element, unsigned long duration,
+                              unsigned long elementGap, unsigned long characterGap) {
+  gapScheduled = true;
+  keyingElement = element;
+  elementStopTime = now + duration;
+  nextElementTime = elementStopTime + elementGap;
+  characterTime = elementStopTime + characterGap;
+  isKeying = true;
+}
+
+bool KeyerState::elementDue(unsigned long now) const {
+  return isKeying && timeReached(now, elementStopTime);
+}
+
+void KeyerState::stopElement(unsigned long now) {
+  isKeying = false;
+  keyReleaseTime = now;
+}
+
+void KeyerState::keyDown(unsigned long now) {
+  gapScheduled = false;
+  keyPressStartTime = now;
+  keyWasPressed = true;
+}
+
+unsigned long KeyerState::keyUp(unsigned long now) {
+  keyWasPressed = false;
+  keyReleaseTime = now;
+  return now - keyPressStartTime;
+}
+
+void DecoderState::reset() {
+  length = 0;
+  wordPending = false;
+  sequence[0] = '\0';
+}
 
 /**
- * @brief Looks up the morseSequence in the table and prints the character to Serial.
+ * @brief Appends a dot or dash without heap allocation. Sequences longer
+ *        than MAX_SEQUENCE_LENGTH are marked so they decode as '?'.
  */
-void decodeAndPrintCharacter() {
-  if (morseSequence.length() == 0) return;
+void DecoderState::append(char element) {
+  if (length < MAX_SEQUENCE_LENGTH) {
+    sequence[length++] = element;
+  } else {
+    sequence[0] = '#'; // Not in MORSE_ALPHABET
+  }
+  sequence[length] = '\0';
+}
+
+void DecoderState::keyUp(unsigned long now, unsigned long boundary) {
+  releaseTime = now;
+  characterTime = boundary;
+}
 
+char DecoderState::take() {
   char decodedChar = '?';
-  const char* sequence_cstr = morseSequence.c_str(); 
 
   // Loop through all 36 possible characters (26 Letters, 10 Numbers)
   for (int i = 0; i < 36; i++) {
     // strcmp is used for C-style string comparison
-    if (strcmp(sequence_cstr, MORSE_ALPHABET[i]) == 0) {
+    if (strcmp(sequence, MORSE_ALPHABET[i]) == 0) {
       if (i < 26) {
         decodedChar = 'A' + i;
       } else {
@@ -144,204 +297,2445 @@ void decodeAndPrintCharacter() {
       break;
     }
   }
+  // Punctuation and prosigns, matched on the packed code
+  if (decodedChar == '?' && sequence[0] != '#') {
+    uint8_t code = 1 << length;
+    for (uint8_t i = 0; i < length; i++) {
+      if (sequence[i] == '-') code |= 1 << i;
+    }
+    for (int i = 0; i < MORSE_PUNCTUATION_COUNT; i++) {
+      if (pgm_read_byte(&MORSE_PUNCTUATION_CODES.codes[i]) == code) {
+        decodedChar = (char)pgm_read_byte(&MORSE_PUNCTUATION[i]);
+        break;
+      }
+    }
+  }
+  length = 0;
+  sequence[0] = '\0';
+  wordPending = false;
+  return decodedChar;
+}
+
+char DecoderState::poll(unsigned long now, unsigned long wordGap) {
+  if (length > 0) {
+    if (!timeReached(now, characterTime)) return '\0';
+    char decodedChar = take();
+    wordPending = true;
+    return decodedChar;
+  }
+  if (wordPending && timeReached(now, releaseTime + wordGap)) {
+    wordPending = false;
+    return ' ';
+  }
+  return '\0';
+}
+
+bool DecoderState::nextDeadline(unsigned long wordGap, unsigned long* deadline) const {
+  if (length > 0) {
+    *deadline = characterTime;
+  } else if (wordPending) {
+    *deadline = releaseTime + wordGap;
+  } else {
+    return false;
+  }
+  return true;
+}
 
-  Serial.print(decodedChar);
-  morseSequence = "";
+/**
+ * @brief The threshold is halfway between a dot and a dash (3 dots);
+ *        presses shorter than half a dot are contact glitches.
+ */
+char classifyPress(unsigned long duration, unsigned long dotDuration) {
+  if (duration >= 3 * dotDuration - dotDuration / 2) return '-';
+  if (duration >= dotDuration - dotDuration / 2) return '.';
+  return '\0';
 }
 
 // =========================================================================
-// IAMBIC KEYER FUNCTIONS
+// SERIAL OUTPUT QUEUE
 // =========================================================================
 
+char txRing[TX_RING_SIZE];
+volatile uint8_t txHead = 0;          // Next free slot (written by loop())
+volatile uint8_t txTail = 0;          // Next byte to send (written by the ISR)
+char statusLine[STATUS_LINE_SIZE];    // Coalesced status line waiting for ring space
+uint8_t statusLength = 0;             // 0 = no status pending
+
 /**
- * @brief Starts a tone element (Dot or Dash) in a non-blocking way.
+ * @brief A fixed-size line being assembled before it is queued.
  */
-void startElement(unsigned int duration, char element) {
-  digitalWrite(LED_PIN, HIGH);
-  tone(BUZZER_PIN, TONE_FREQ);
-  
-  morseSequence += element;
-  elementStopTime = millis() + duration;
-  nextElementTime = elementStopTime + ELEMENT_GAP;
-  isKeying = true;
-}
+struct LineBuffer {
+  char text[STATUS_LINE_SIZE];
+  uint8_t length;
+};
 
-void sendDot() {
-  startElement(DOT_DURATION, '.');
-  
-  if (currentIambicMode == MODE_B) {
-    iambicBuffer = true; // Buffer for the next Dash
+// --- Decode latency stamps (see DECODE LATENCY TIMESTAMPS) ---
+// Each decoded symbol takes a slot; the UDRE ISR records when the ring slot
+// holding that symbol is written to UDR0. Slots move through
+// stampOut <= stampSent <= stampQueued <= stampIn.
+const uint8_t STAMP_SLOTS = 4;        // Power of two
+struct SymbolStamp {
+  char symbol;
+  bool lost;                          // Overwritten (TX_DROP_OLDEST) before reaching the UART
+  uint8_t txIndex;                    // txRing slot holding the symbol
+  unsigned long closeTime;            // halMicros() when the character gap closed
+  unsigned long uartTime;             // halMicros() when the byte was written to UDR0
+};
+volatile SymbolStamp stamps[STAMP_SLOTS];
+uint8_t stampIn = 0;                  // Next free slot
+volatile uint8_t stampQueued = 0;     // Slots below this have their byte in txRing
+volatile uint8_t stampSent = 0;       // Slots below this have left txRing (ISR)
+uint8_t stampOut = 0;                 // Next slot to report
+
+/**
+ * @brief Called with interrupts off as txRing[index] leaves the ring.
+ */
+inline void stampByteLeaving(uint8_t index, bool lost) {
+  uint8_t slot = stampSent;
+  if (slot != stampQueued && stamps[slot & (STAMP_SLOTS - 1)].txIndex == index) {
+    stamps[slot & (STAMP_SLOTS - 1)].uartTime = halMicros();
+    stamps[slot & (STAMP_SLOTS - 1)].lost = lost;
+    stampSent = slot + 1;
   }
 }
 
-void sendDash() {
-  startElement(DASH_DURATION, '-');
-  
-  if (currentIambicMode == MODE_B) {
-    iambicBuffer = false; // Buffer for the next Dot
+char rxRing[RX_RING_SIZE];
+volatile uint8_t rxHead = 0;          // Written by the ISR
+volatile uint8_t rxTail = 0;          // Written by loop()
+volatile uint8_t rxFramingErrors = 0; // Consecutive bytes received with a framing error
+unsigned long currentBaud = SAFE_BAUD;
+
+/**
+ * @brief (Re)starts the UART at the given baud rate.
+ */
+void serialBegin(unsigned long baud) {
+  halSerialBegin(baud);
+  rxFramingErrors = 0;
+  currentBaud = baud;
+}
+
+/**
+ * @brief Receive interrupt handler: stores one byte in rxRing.
+ */
+void serialRxByte(uint8_t c, bool framingError) {
+  if (framingError) {
+    if (rxFramingErrors < 255) rxFramingErrors++;
+    return;
+  }
+  rxFramingErrors = 0;
+  uint8_t next = (rxHead + 1) & (RX_RING_SIZE - 1);
+  if (next != rxTail) {
+    rxRing[rxHead] = c;
+    rxHead = next;
   }
 }
 
 /**
- * @brief Manages the non-blocking tone output and timing.
+ * @brief Transmit interrupt handler: hands the next queued byte to the UART.
  */
-void handleKeyerOutput() {
-  if (isKeying) {
-    if (millis() >= elementStopTime) {
-      noTone(BUZZER_PIN);
-      digitalWrite(LED_PIN, LOW);
-      isKeying = false;
-      keyReleaseTime = millis();
+bool serialTxNext(uint8_t* data) {
+  uint8_t tail = txTail;
+  if (tail == txHead) return false;
+  *data = txRing[tail];
+  stampByteLeaving(tail, false);
+  txTail = tail + 1;
+  return true;
+}
+
+/**
+ * @brief True once every queued byte has left the shift register.
+ */
+bool serialIdle() {
+  return txHead == txTail && halSerialIdle();
+}
+
+/**
+ * @brief Returns the next received byte, or -1 if none is waiting.
+ */
+int rxRead() {
+  uint8_t tail = rxTail;
+  if (tail == rxHead) return -1;
+  char c = rxRing[tail];
+  rxTail = (tail + 1) & (RX_RING_SIZE - 1);
+  return (uint8_t)c;
+}
+
+/**
+ * @brief Number of bytes that can be queued without overflowing.
+ */
+uint8_t txFree() {
+  return (uint8_t)(txTail - txHead - 1);
+}
+
+/**
+ * @brief Queues one byte, applying TX_OVERFLOW_POLICY when the ring is full.
+ */
+void txPrint(char c) {
+  uint8_t head = txHead;
+  if ((uint8_t)(head + 1) == txTail) {
+    if (TX_OVERFLOW_POLICY != TX_DROP_OLDEST) return;
+    uint8_t state = halInterruptsOff();
+    if ((uint8_t)(head + 1) == txTail) {
+      stampByteLeaving(txTail, true);
+      txTail++;
     }
+    halInterruptsRestore(state);
   }
+  txRing[head] = c;
+  txHead = head + 1;
+  halSerialKick();
 }
 
+void txPrint(const char* text) {
+  while (*text) txPrint(*text++);
+}
 
-// =========================================================================
-// STRAIGHT KEY HELPER FUNCTIONS
-// =========================================================================
+void txPrint(unsigned long value) {
+  char digits[11];
+  uint8_t count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  while (count > 0) txPrint(digits[--count]);
+}
 
-void handleKeyPress() {
-  keyPressStartTime = millis();
-  keyWasPressed = true;
-  digitalWrite(LED_PIN, HIGH);
-  tone(BUZZER_PIN, TONE_FREQ);
+void txPrintln() {
+  txPrint("\r\n");
 }
 
-void handleKeyRelease() {
-  unsigned long keyPressDuration = millis() - keyPressStartTime;
-  keyWasPressed = false;
-  noTone(BUZZER_PIN);
-  digitalWrite(LED_PIN, LOW);
-  keyReleaseTime = millis();
+void txPrintln(const char* text) {
+  txPrint(text);
+  txPrintln();
+}
 
-  // Determine if the press was a dot or a dash based on dynamic timing ratios
-  // The threshold is halfway between DOT_DURATION and DASH_DURATION (3*DOT_DURATION)
-  if (keyPressDuration >= (DASH_DURATION - DOT_DURATION / 2)) {
-    morseSequence += "-";
-  } else if (keyPressDuration >= (DOT_DURATION - DOT_DURATION / 2)) {
-    morseSequence += ".";
+void lineAppend(LineBuffer& line, const char* text) {
+  while (*text && line.length < STATUS_LINE_SIZE) {
+    line.text[line.length++] = *text++;
+  }
+}
+
+void lineAppend(LineBuffer& line, unsigned long value) {
+  char digits[11];
+  uint8_t count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  while (count > 0 && line.length < STATUS_LINE_SIZE) {
+    line.text[line.length++] = digits[--count];
+  }
+}
+
+/**
+ * @brief Queues a status line. Under TX_COALESCE_STATUS a line that does
+ *        not fit replaces any older status still waiting for ring space.
+ */
+void txStatus(const LineBuffer& line) {
+  if (TX_OVERFLOW_POLICY != TX_COALESCE_STATUS || (statusLength == 0 && txFree() >= line.length)) {
+    for (uint8_t i = 0; i < line.length; i++) txPrint(line.text[i]);
+    return;
   }
+  memcpy(statusLine, line.text, line.length);
+  statusLength = line.length;
 }
 
+/**
+ * @brief Moves a coalesced status line into the ring once it fits whole.
+ */
+void txService() {
+  if (statusLength == 0 || txFree() < statusLength) return;
+  for (uint8_t i = 0; i < statusLength; i++) txPrint(statusLine[i]);
+  statusLength = 0;
+}
 
 // =========================================================================
-// SETUP FUNCTION
+// DECODE LATENCY TIMESTAMPS
 // =========================================================================
-void setup() {
-  Serial.begin(9600);
-  
-  pinMode(LED_PIN, OUTPUT);
-  pinMode(BUZZER_PIN, OUTPUT);
+// Every decoded character is timed from the moment its character gap
+// closed (last release + CHARACTER_GAP), and every word space from the
+// moment its word gap closed, to the moment its byte was written to the
+// UART, covering loop() detection, the lookup and serial queueing.
+// "LAT" reports min/avg/p99/max and how many symbols found all
+// STAMP_SLOTS busy and went untimed; with "STAMP ON" each symbol is
+// printed on its own line (a word space as a line starting with ' ') as:
+//   <symbol> <gap closed us> <uart us> <latency us>
+// The next symbol's line is held back until the previous one is complete,
+// so with STAMP ON an untimed symbol is not printed at all.
 
-  // Initial call to set the default WPM and print the speed
-  updateWPM(); 
+const uint8_t LATENCY_BUCKETS = 16;   // Bucket i counts latencies below 2^(i+1) us
 
-  // --- Runtime Configuration Check and Setup ---
-  if (IAMBIC_MODE == 1) {
-    pinMode(DOT_PIN, INPUT_PULLUP);
-    pinMode(DASH_PIN, INPUT_PULLUP);
-    String modeName = (currentIambicMode == MODE_A) ? "Mode A (No Memory)" : "Mode B (Squeeze Memory)";
-    Serial.println("Arduino Iambic Keyer Trainer Ready!");
-    Serial.println("Current Mode: " + modeName);
-  } 
-  
-  if (STRAIGHT_KEY_MODE == 1) {
-    pinMode(STRAIGHT_KEY_PIN, INPUT_PULLUP);
-    Serial.println("Arduino Straight Key Decoder Ready!");
+bool stampMode = false;
+unsigned long latencyCount = 0;
+unsigned long latencyMin = 0xFFFFFFFFUL;
+unsigned long latencyMax = 0;
+unsigned long latencySum = 0;
+uint16_t latencyHistogram[LATENCY_BUCKETS];
+unsigned long latencyUntimed = 0;     // Symbols that found no free stamp slot
+
+void recordLatency(unsigned long latency) {
+  uint8_t bucket = 0;
+  while (bucket < LATENCY_BUCKETS - 1 && (latency >> (bucket + 1)) != 0) bucket++;
+  if (latencyHistogram[bucket] < 0xFFFF) latencyHistogram[bucket]++;
+  latencyCount++;
+  latencySum += latency;
+  if (latency < latencyMin) latencyMin = latency;
+  if (latency > latencyMax) latencyMax = latency;
+}
+
+void resetLatency() {
+  latencyCount = 0;
+  latencyMin = 0xFFFFFFFFUL;
+  latencyMax = 0;
+  latencySum = 0;
+  memset(latencyHistogram, 0, sizeof(latencyHistogram));
+  latencyUntimed = 0;
+}
+
+/**
+ * @brief Prints the aggregated latency. p99 is the upper edge of the
+ *        histogram bucket holding the 99th percentile.
+ */
+void printLatency() {
+  txPrint("LAT n=");
+  txPrint(latencyCount);
+  txPrint(" untimed=");
+  txPrint(latencyUntimed);
+  if (latencyCount > 0) {
+    unsigned long target = latencyCount - latencyCount / 100;
+    unsigned long seen = 0;
+    uint8_t bucket = 0;
+    for (; bucket < LATENCY_BUCKETS - 1; bucket++) {
+      seen += latencyHistogram[bucket];
+      if (seen >= target) break;
+    }
+    txPrint(" min=");
+    txPrint(latencyMin);
+    txPrint(" avg=");
+    txPrint(latencySum / latencyCount);
+    txPrint(" p99<=");
+    txPrint(2UL << bucket);
+    txPrint(" max=");
+    txPrint(latencyMax);
   }
+  txPrintln(" us");
+}
 
-  // Final check for configuration error
-  if (IAMBIC_MODE == 0 && STRAIGHT_KEY_MODE == 0) {
-    Serial.println("ERROR: No Keyer Mode is Active. Set IAMBIC_MODE or STRAIGHT_KEY_MODE to 1.");
+/**
+ * @brief Reports symbols that have reached the UART and queues waiting ones.
+ */
+void handleStamps() {
+  while (stampOut != stampSent) {
+    volatile SymbolStamp& stamp = stamps[stampOut & (STAMP_SLOTS - 1)];
+    unsigned long latency = stamp.uartTime - stamp.closeTime;
+    if ((long)latency < 0) latency = 0; // Send queue decodes right at the gap edge
+    if (!stamp.lost) recordLatency(latency);
+    if (stampMode) {
+      if (stamp.lost) {
+        txPrintln(" lost");
+      } else {
+        txPrint(' ');
+        txPrint(stamp.uartTime);
+        txPrint(' ');
+        txPrint(latency);
+        txPrintln();
+      }
+    }
+    stampOut++;
   }
-  
-  Serial.println("Start keying!");
+
+  while (stampQueued != stampIn) {
+    if (stampMode && stampOut != stampQueued) break; // Previous line still open
+    if (txFree() < (stampMode ? 12 : 1)) break;
+    volatile SymbolStamp& stamp = stamps[stampQueued & (STAMP_SLOTS - 1)];
+    stamp.txIndex = txHead;
+    stampQueued++;                   // Arm the ISR before the byte can leave
+    txPrint(stamp.symbol);
+    if (stampMode) {
+      txPrint(' ');
+      txPrint(stamp.closeTime);
+    }
+  }
+}
+
+/**
+ * @brief Queues a decoded symbol for output and latency measurement.
+ */
+void stampSymbol(char symbol, unsigned long closeTime) {
+  if ((uint8_t)(stampIn - stampOut) >= STAMP_SLOTS) {
+    latencyUntimed++;
+    if (!stampMode) txPrint(symbol); // No slot free: print untimed
+    return;
+  }
+  volatile SymbolStamp& stamp = stamps[stampIn & (STAMP_SLOTS - 1)];
+  stamp.symbol = symbol;
+  stamp.closeTime = closeTime;
+  stamp.lost = false;
+  stampIn++;
+  handleStamps();
 }
 
 // =========================================================================
-// MAIN LOOP
+// ELEMENT TIMING JITTER
 // =========================================================================
-void loop() {
-  
-  // 1. ALWAYS UPDATE SPEED FIRST
-  updateWPM(); 
-  
-  // --- Iambic Keyer Logic (Controlled by runtime IF) ---
-  if (IAMBIC_MODE == 1) {
-    
-    // 2. TONE MANAGEMENT: Must handle tone output first to maintain non-blocking timing.
-    handleKeyerOutput();
-
-    // 3. INPUT: Read the current paddle states (LOW means pressed, due to PULLUP)
-    dotPaddleState = !digitalRead(DOT_PIN);
-    dashPaddleState = !digitalRead(DASH_PIN);
-
-    // 4. DECODE: Character/Word Detection (only check if we are NOT currently sending an element)
-    if (!isKeying && morseSequence.length() > 0) {
-      unsigned long timeSinceLastElement = millis() - keyReleaseTime;
-      
-      if (timeSinceLastElement > CHARACTER_GAP) {
-        decodeAndPrintCharacter();
-        if (timeSinceLastElement > WORD_GAP) {
-          Serial.print(" ");
-        }
-      }
+// Every edge the keyer generates is compared with its schedule: an
+// element's end with elementStopTime and an element's start with
+// nextElementTime, when the gap before it was scheduled (not the first
+// element after the paddles or the send queue were idle). The lateness
+// goes into a log2 histogram per kind. Straight-key edges follow the
+// operator's hand and are not counted. "JIT" prints:
+//   JIT <wpm> WPM <mode>
+//   JIT <dot|dash|gap> n=<count> max=<us> <2:<count> <4:<count> ... >=2048:<count>
+// (empty buckets are left out); "JIT RESET" clears the tables, e.g. after
+// changing speed or mode.
+
+enum JitterKind {
+  JIT_DOT,
+  JIT_DASH,
+  JIT_GAP,
+  JIT_KINDS
+};
+
+const uint8_t JITTER_BUCKETS = 12;    // Bucket i counts lateness below 2^(i+1) us; the last is open
+const uint8_t JITTER_LINE_MAX = 176;  // Longest "JIT" line, with every bucket filled
+const char* const JITTER_NAMES[JIT_KINDS] = { "dot", "dash", "gap" };
+
+uint16_t jitterHistogram[JIT_KINDS][JITTER_BUCKETS];
+unsigned long jitterMax[JIT_KINDS];
+uint8_t jitterDumpLine = JIT_KINDS + 1; // Next line of a "JIT" report (0 = header); JIT_KINDS + 1 = none
+
+void recordJitter(uint8_t kind, unsigned long lateness) {
+  uint8_t bucket = 0;
+  while (bucket < JITTER_BUCKETS - 1 && (lateness >> (bucket + 1)) != 0) bucket++;
+  if (jitterHistogram[kind][bucket] < 0xFFFF) jitterHistogram[kind][bucket]++;
+  if (lateness > jitterMax[kind]) jitterMax[kind] = lateness;
+}
+
+void resetJitter() {
+  memset(jitterHistogram, 0, sizeof(jitterHistogram));
+  memset(jitterMax, 0, sizeof(jitterMax));
+}
+
+/**
+ * @brief Prints the next line of a "JIT" report once it fits in the ring.
+ */
+void handleJitterDump() {
+  if (jitterDumpLine > JIT_KINDS || txFree() < JITTER_LINE_MAX) return;
+  if (jitterDumpLine == 0) {
+    txPrint("JIT ");
+    txPrint((unsigned long)currentWPM);
+    txPrint(" WPM ");
+    if (!iambicModeActive) {
+      txPrintln("STRAIGHT");
+    } else if (straightKeyModeActive) {
+      txPrintln("AUTO");
+    } else {
+      txPrintln(PADDLE_MODE_NAMES[currentIambicMode]);
     }
+    jitterDumpLine++;
+    return;
+  }
 
-    // 5. KEYER LOGIC: Only start a new element if timing is met (millis() >= nextElementTime)
-    if (millis() >= nextElementTime) {
-      
-      // Check for alternating (both paddles pressed - SQUEEZE)
-      if (dotPaddleState && dashPaddleState) {
-        if (iambicBuffer) {
-          sendDot();
-        } else {
-          sendDash();
-        }
-      } 
-      // Check for single paddle press (Dot)
-      else if (dotPaddleState) {
-        sendDot();
-      } 
-      // Check for single paddle press (Dash)
-      else if (dashPaddleState) {
-        sendDash();
-      } else {
-        // If no paddles are pressed, reset the next start time to now 
-        nextElementTime = millis();
-        
-        // In MODE A, reset the buffer when both paddles are released.
-        if (currentIambicMode == MODE_A) {
-            iambicBuffer = false; 
-        }
-      }
+  uint8_t kind = jitterDumpLine - 1;
+  unsigned long count = 0;
+  for (uint8_t i = 0; i < JITTER_BUCKETS; i++) count += jitterHistogram[kind][i];
+  txPrint("JIT ");
+  txPrint(JITTER_NAMES[kind]);
+  txPrint(" n=");
+  txPrint(count);
+  txPrint(" max=");
+  txPrint(jitterMax[kind]);
+  for (uint8_t i = 0; i < JITTER_BUCKETS; i++) {
+    if (jitterHistogram[kind][i] == 0) continue;
+    if (i < JITTER_BUCKETS - 1) {
+      txPrint(" <");
+      txPrint(2UL << i);
+    } else {
+      txPrint(" >=");
+      txPrint(1UL << i);
     }
-  } // End IAMBIC_MODE
+    txPrint(':');
+    txPrint((unsigned long)jitterHistogram[kind][i]);
+  }
+  txPrintln();
+  jitterDumpLine++;
+}
 
-  // --- Straight Key Logic (Controlled by runtime IF) ---
-  if (STRAIGHT_KEY_MODE == 1) {
-    int keyState = digitalRead(STRAIGHT_KEY_PIN);
+// =========================================================================
+// LOOP PROFILER (PROFILE_ENABLED only)
+// =========================================================================
+// Timer1 runs at the CPU clock; each phase is timed as a 16-bit cycle
+// difference, so a single phase longer than 4.096 ms wraps. The cost of
+// the timing itself is measured once in setup() and subtracted. Counts
+// saturate by halving count and sum together, which keeps the mean.
+// "PROF" prints one line per phase (one line per pass, as ring space
+// allows): PROF <phase> n=<count> min=<cycles> avg=<cycles> max=<cycles>
 
-    if (keyState == LOW) {
-      if (!keyWasPressed) {
-        handleKeyPress();
-      }
+enum ProfilePhase {
+  PROF_LOOP,          // A whole loop() pass
+  PROF_SERIAL_OUT,    // txService(), handleStamps() and the PROF dump
+  PROF_COMMANDS,      // Host input, baud negotiation, pending settings
+  PROF_UPDATE_WPM,
+  PROF_KEYER_OUTPUT,  // handleKeyerOutput()
+  PROF_READ_KEYS,
+  PROF_DECODE,        // Character decode and word space
+  PROF_KEYER,         // Element scheduling: iambic, straight key, send queue
+  PROF_PHASES
+};
+
+#if PROFILE_ENABLED
+const char* const PROFILE_NAMES[PROF_PHASES] = {
+  "loop", "serial_out", "commands", "update_wpm", "keyer_output", "read_keys", "decode", "keyer"
+};
+
+struct ProfileStat {
+  uint16_t minimum;
+  uint16_t maximum;
+  uint16_t count;
+  uint32_t sum;
+};
+
+ProfileStat profileStats[PROF_PHASES];
+uint16_t profileOverhead = 0;           // Cycles of an empty measurement
+uint8_t profileDumpLine = PROF_PHASES;  // Next line of a "PROF" report; PROF_PHASES = none
+
+void profileRecord(uint8_t phase, uint16_t cycles) {
+  cycles = (cycles > profileOverhead) ? cycles - profileOverhead : 0;
+  ProfileStat& stat = profileStats[phase];
+  if (stat.count == 0xFFFF) {
+    stat.count >>= 1;
+    stat.sum >>= 1;
+  }
+  stat.count++;
+  stat.sum += cycles;
+  if (cycles < stat.minimum) stat.minimum = cycles;
+  if (cycles > stat.maximum) stat.maximum = cycles;
+}
+
+void resetProfile() {
+  for (uint8_t i = 0; i < PROF_PHASES; i++) {
+    profileStats[i].minimum = 0xFFFF;
+    profileStats[i].maximum = 0;
+    profileStats[i].count = 0;
+    profileStats[i].sum = 0;
+  }
+}
+
+/**
+ * @brief Starts the cycle counter and measures the cost of one measurement.
+ */
+void profileBegin() {
+  halCycleCounterBegin();
+  resetProfile();
+  profileOverhead = 0xFFFF;
+  for (uint8_t i = 0; i < 8; i++) {
+    uint16_t start = halCycles();
+    uint16_t cycles = halCycles() - start;
+    if (cycles < profileOverhead) profileOverhead = cycles;
+  }
+}
+
+/**
+ * @brief Prints the next line of a "PROF" report once it fits in the ring.
+ */
+void handleProfileDump() {
+  if (profileDumpLine >= PROF_PHASES || txFree() < STATUS_LINE_SIZE) return;
+  const ProfileStat& stat = profileStats[profileDumpLine];
+  txPrint("PROF ");
+  txPrint(PROFILE_NAMES[profileDumpLine]);
+  txPrint(" n=");
+  txPrint((unsigned long)stat.count);
+  if (stat.count > 0) {
+    txPrint(" min=");
+    txPrint((unsigned long)stat.minimum);
+    txPrint(" avg=");
+    txPrint((unsigned long)(stat.sum / stat.count));
+    txPrint(" max=");
+    txPrint((unsigned long)stat.maximum);
+  }
+  txPrintln();
+  profileDumpLine++;
+}
+
+/**
+ * @brief Times the enclosing block (used where a block has several exits).
+ */
+struct ProfileScope {
+  uint8_t phase;
+  uint16_t start;
+  ProfileScope(uint8_t p) : phase(p), start(halCycles()) {}
+  ~ProfileScope() { profileRecord(phase, halCycles() - start); }
+};
+
+#define PROFILE_BEGIN(phase) uint16_t profileStart_##phase = halCycles()
+#define PROFILE_END(phase) profileRecord(phase, halCycles() - profileStart_##phase)
+#define PROFILE_SCOPE(phase) ProfileScope profileScope_##phase(phase)
+#else
+#define PROFILE_BEGIN(phase)
+#define PROFILE_END(phase)
+#define PROFILE_SCOPE(phase)
+#endif
+
+// =========================================================================
+// BINARY TELEMETRY
+// =========================================================================
+// While enabled, decoded text and status lines are suppressed and every
+// key edge, element, gap, decoded symbol and speed change is sent as one
+// frame:
+//
+//   COBS( type, delta, payload..., crc_lo, crc_hi ) 0x00
+//
+// delta is the time since the previous record in microseconds as an
+// unsigned LEB128 varint, so records a few milliseconds apart take two or
+// three bytes. The CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+// over the unencoded bytes before it. A dot at 60 WPM produces about
+// 38 bytes (key down, element, key up, gap) per 40 ms, under 9% of the
+// 115200 baud link.
+
+enum TelemetryType {
+  TLM_KEY_DOWN = 1,    // no payload
+  TLM_KEY_UP = 2,      // no payload
+  TLM_ELEMENT = 3,     // '.' or '-', duration varint (us)
+  TLM_GAP = 4,         // 'e'lement, 'c'haracter or 'w'ord, duration varint (us)
+  TLM_SYMBOL = 5,      // decoded character
+  TLM_SPEED = 6        // WPM, dot duration varint (us)
+};
+
+const uint8_t TLM_MAX_RECORD = 16;    // type + 2 varints + class byte + CRC, < 254 so one COBS block
+
+bool telemetryEnabled = TELEMETRY_DEFAULT;
+unsigned long lastTelemetryTime = 0;  // halMicros() of the previous record
+
+uint16_t crc16Update(uint16_t crc, uint8_t data) {
+  crc ^= (uint16_t)data << 8;
+  for (uint8_t i = 0; i < 8; i++) {
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+uint8_t putVarint(uint8_t* out, unsigned long value) {
+  uint8_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  out[length++] = (uint8_t)value;
+  return length;
+}
+
+/**
+ * @brief COBS-encodes a record shorter than 254 bytes; returns the encoded length.
+ */
+uint8_t cobsEncode(const uint8_t* in, uint8_t length, uint8_t* out) {
+  uint8_t codeIndex = 0;
+  uint8_t code = 1;
+  uint8_t o = 1;
+  for (uint8_t i = 0; i < length; i++) {
+    if (in[i] == 0) {
+      out[codeIndex] = code;
+      codeIndex = o++;
+      code = 1;
     } else {
-      if (keyWasPressed) {
-        handleKeyRelease();
-      }
-      
-      // Character/Word Detection (Uses time since last release)
-      unsigned long timeSinceLastRelease = millis() - keyReleaseTime;
-      if (morseSequence.length() > 0) {
-        if (timeSinceLastRelease > CHARACTER_GAP) {
-          decodeAndPrintCharacter();
-        }
-        if (timeSinceLastRelease > WORD_GAP) {
-          Serial.print(" ");
-        }
-      }
+      out[o++] = in[i];
+      code++;
     }
-  } // End STRAIGHT_KEY_MODE
+  }
+  out[codeIndex] = code;
+  return o;
+}
+
+/**
+ * @brief Frames and queues one record. Frames that do not fit whole are dropped
+ *        (except under TX_DROP_OLDEST, where the host resynchronises on 0x00).
+ */
+void telemetryEmit(uint8_t type, unsigned long timestamp, const uint8_t* payload, uint8_t payloadLength) {
+  if (!telemetryEnabled) return;
+
+  // Records are emitted in program order; never let the delta go negative
+  if ((long)(timestamp - lastTelemetryTime) < 0) timestamp = lastTelemetryTime;
+
+  uint8_t record[TLM_MAX_RECORD];
+  uint8_t length = 0;
+  record[length++] = type;
+  length += putVarint(record + length, timestamp - lastTelemetryTime);
+  memcpy(record + length, payload, payloadLength);
+  length += payloadLength;
+
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < length; i++) crc = crc16Update(crc, record[i]);
+  record[length++] = (uint8_t)crc;
+  record[length++] = (uint8_t)(crc >> 8);
+
+  uint8_t frame[TLM_MAX_RECORD + 2];
+  uint8_t frameLength = cobsEncode(record, length, frame);
+  frame[frameLength++] = 0x00;
+
+  if (txFree() < frameLength && TX_OVERFLOW_POLICY != TX_DROP_OLDEST) return;
+  lastTelemetryTime = timestamp;
+  for (uint8_t i = 0; i < frameLength; i++) txPrint((char)frame[i]);
+}
+
+void telemetryKeyEdge(bool down, unsigned long timestamp) {
+  telemetryEmit(down ? TLM_KEY_DOWN : TLM_KEY_UP, timestamp, NULL, 0);
+}
+
+void telemetryElement(char element, unsigned long duration, unsigned long timestamp) {
+  uint8_t payload[6];
+  payload[0] = element;
+  uint8_t length = 1 + putVarint(payload + 1, duration);
+  telemetryEmit(TLM_ELEMENT, timestamp, payload, length);
+}
+
+/**
+ * @brief Classifies the gap that just ended at the midpoints between the
+ *        element, character and word gap lengths.
+ */
+void telemetryGap(unsigned long duration, unsigned long timestamp) {
+  uint8_t payload[6];
+  if (duration < (ELEMENT_GAP + CHARACTER_GAP) / 2) {
+    payload[0] = 'e';
+  } else if (duration < (CHARACTER_GAP + WORD_GAP) / 2) {
+    payload[0] = 'c';
+  } else {
+    payload[0] = 'w';
+  }
+  uint8_t length = 1 + putVarint(payload + 1, duration);
+  telemetryEmit(TLM_GAP, timestamp, payload, length);
+}
+
+void telemetrySymbol(char symbol) {
+  uint8_t payload = symbol;
+  telemetryEmit(TLM_SYMBOL, halMicros(), &payload, 1);
+}
+
+void telemetrySpeed() {
+  uint8_t payload[6];
+  payload[0] = currentWPM;
+  uint8_t length = 1 + putVarint(payload + 1, DOT_DURATION);
+  telemetryEmit(TLM_SPEED, halMicros(), payload, length);
+}
+
+// =========================================================================
+// BEACON FUNCTIONS (QRSS / DFCW)
+// =========================================================================
+// Element deadlines are kept in halMillis() and advanced by adding durations
+// to the previous deadline, so the beacon never drifts and survives the
+// 49-day halMillis() wrap via timeReached(). Between transitions the CPU
+// sits in idle sleep; with the key up the sidetone interrupt is masked
+// (halKeyOutput()), so only Timer0's millisecond tick wakes it.
+
+MORSE_MESSAGE(BEACON_CODES, BEACON_MESSAGE); // Encoded at compile time
+
+uint8_t beaconCharIndex = 0;          // Position in BEACON_MESSAGE / BEACON_CODES
+uint8_t beaconCode = MORSE_CODE_WORD_SPACE; // Remaining elements of the current character
+bool beaconToneOn = false;
+unsigned long beaconDeadline = 0;     // halMillis() of the next transition
+
+/**
+ * @brief Advances the beacon by one transition and schedules the next one.
+ */
+void handleBeacon() {
+  if (!timeReached(halMillis(), beaconDeadline)) {
+    halSleep(); // Idle sleep; Timer0 wakes us within ~1 ms
+    return;
+  }
+
+  if (beaconToneOn) {
+    // End of element: pick element, character or word spacing
+    halKeyOutput(false);
+    telemetryKeyEdge(false, halMicros());
+    beaconToneOn = false;
+    beaconCode >>= 1;
+
+    unsigned long gap = (BEACON_MODE == BEACON_DFCW) ? QRSS_DOT_MS / 3 : QRSS_DOT_MS;
+    if (beaconCode == MORSE_CODE_WORD_SPACE) {
+      beaconCharIndex++;
+      gap = 3 * QRSS_DOT_MS;
+      if (pgm_read_byte(&BEACON_CODES.codes[beaconCharIndex]) <= MORSE_CODE_WORD_SPACE) {
+        gap = 7 * QRSS_DOT_MS; // Space or end of the message
+      }
+    }
+    beaconDeadline += gap;
+    return;
+  }
+
+  // Fetch the next character; skip spaces and wrap to the start of the message
+  bool characterStart = beaconCode <= MORSE_CODE_WORD_SPACE;
+  for (uint8_t skipped = 0; beaconCode <= MORSE_CODE_WORD_SPACE; skipped++) {
+    if (skipped > sizeof(BEACON_MESSAGE)) return; // Nothing but spaces to send
+    beaconCode = pgm_read_byte(&BEACON_CODES.codes[beaconCharIndex]);
+    if (beaconCode == MORSE_CODE_NONE) {
+      beaconCharIndex = 0;
+    } else if (beaconCode == MORSE_CODE_WORD_SPACE) {
+      beaconCharIndex++;
+    }
+  }
+
+  bool dash = beaconCode & 1;
+  unsigned long duration = QRSS_DOT_MS;
+  if (BEACON_MODE == BEACON_DFCW) {
+    halSidetoneFrequency(dash ? toneFrequency + DFCW_SHIFT_HZ : toneFrequency);
+  } else if (dash) {
+    duration = 3 * QRSS_DOT_MS;
+  }
+  if (characterStart) {
+    if (telemetryEnabled) {
+      telemetrySymbol(BEACON_MESSAGE[beaconCharIndex]);
+    } else {
+      txPrint(BEACON_MESSAGE[beaconCharIndex]);
+    }
+  }
+
+  halKeyOutput(true);
+  telemetryKeyEdge(true, halMicros());
+  beaconToneOn = true;
+  beaconDeadline += duration;
+}
+
+// =========================================================================
+// WPM Update Function
+// =========================================================================
+/**
+ * @brief Harvests a finished pot conversion (if any) without waiting for the
+ *        ADC and recalculates all Morse timing variables when the speed changes.
+ */
+void updateWPM() {
+  if (speedFromCommand) return;   // Speed was set over serial
+
+  // Read the potentiometer value (0 to 1023)
+  int sensorValue;
+  if (!halPotRead(&sensorValue)) return; // Conversion still in progress
+
+  applyPotReading(sensorValue);
+}
+
+/**
+ * @brief Maps a 0..1023 pot reading to MIN_WPM..MAX_WPM (as Arduino map()).
+ */
+int potToWPM(int sensorValue) {
+  return MIN_WPM + (long)sensorValue * (MAX_WPM - MIN_WPM) / 1023;
+}
+
+/**
+ * @brief Maps a potentiometer reading to WPM and updates the timing variables.
+ */
+void applyPotReading(int sensorValue) {
+  // Ignore ADC noise around the current setting so the speed does not flap
+  int potChange = sensorValue - lastPotReading;
+  if (potChange > -POT_HYSTERESIS && potChange < POT_HYSTERESIS) return;
+
+  // Map the sensor value to the WPM range (MIN_WPM to MAX_WPM)
+  int newWPM = potToWPM(sensorValue);
+  
+  // Only update if the speed has changed
+  if (newWPM != currentWPM || lastPotReading < 0) {
+    lastPotReading = sensorValue;
+    setSpeed(newWPM);
+    winkeyerReportPot();
+  }
+}
+
+/**
+ * @brief Sets the character speed, recalculates all timing variables and
+ *        reports the change.
+ */
+void setSpeed(int wpm) {
+  currentWPM = wpm;
+
+  // Recalculate all timing variables based on the new WPM
+  DOT_DURATION = 1200000UL / currentWPM; 
+  DASH_DURATION = 3 * DOT_DURATION;
+  ELEMENT_GAP = DOT_DURATION; 
+  CHARACTER_GAP = 3 * DOT_DURATION; 
+  WORD_GAP = 7 * DOT_DURATION;
+
+  // Farnsworth: keep the characters at currentWPM but stretch the spacing
+  // so the overall rate is farnsworthWPM (ARRL formula, in microseconds:
+  // total delay per word = 60/e - 37.2/c seconds, split 3:7 over the
+  // 19 spacing units of PARIS)
+  if (farnsworthWPM > 0 && farnsworthWPM < currentWPM) {
+    unsigned long totalDelay = 60000000UL / farnsworthWPM - 37200000UL / currentWPM;
+    CHARACTER_GAP = 3 * totalDelay / 19;
+    WORD_GAP = 7 * totalDelay / 19;
+  }
+  
+  if (telemetryEnabled) {
+    telemetrySpeed();
+    return;
+  }
+  if (winkeyerActive()) return; // The host only expects protocol bytes
+
+  // Output the new speed to the Serial Monitor
+  LineBuffer line;
+  line.length = 0;
+  lineAppend(line, "\nSpeed: ");
+  lineAppend(line, (unsigned long)currentWPM);
+  if (farnsworthWPM > 0 && farnsworthWPM < currentWPM) {
+    lineAppend(line, "/");
+    lineAppend(line, (unsigned long)farnsworthWPM);
+  }
+  lineAppend(line, " WPM | Dot: ");
+  lineAppend(line, DOT_DURATION / 1000);
+  lineAppend(line, ".");
+  lineAppend(line, (DOT_DURATION / 100) % 10);
+  lineAppend(line, "ms\r\n");
+  txStatus(line);
+}
+
+// =========================================================================
+// UNIVERSAL HELPER FUNCTIONS
+// =========================================================================
+
+/**
+ * @brief Queues a decoded character for output.
+ */
+void printCharacter(char decodedChar) {
+  if (telemetryEnabled) {
+    telemetrySymbol(decodedChar);
+  } else {
+    stampSymbol(decodedChar, decoder.characterTime);
+  }
+}
+
+/**
+ * @brief Decodes the collected sequence at once (send queue echo).
+ */
+void decodeAndPrintCharacter() {
+  if (decoder.length == 0) return;
+  printCharacter(decoder.take());
+}
+
+/**
+ * @brief Prints the space between decoded words, timed like a character
+ *        from closeTime (plain text output only).
+ */
+void printWordSpace(unsigned long closeTime) {
+  if (!telemetryEnabled) stampSymbol(' ', closeTime);
+}
+
+/**
+ * @brief Prints the character, then the word space, once its gap has
+ *        passed. Call only while the key is up.
+ */
+void handleDecoder() {
+  char symbol = decoder.poll(halMicros(), WORD_GAP);
+  if (symbol == ' ') {
+    printWordSpace(decoder.releaseTime + WORD_GAP);
+  } else if (symbol != '\0') {
+    printCharacter(symbol);
+  }
+}
+
+/**
+ * @brief Packed element code of a letter, digit or punctuation mark,
+ *        MORSE_CODE_WORD_SPACE for ' ', or MORSE_CODE_NONE: flash reads
+ *        only, no pattern walk.
+ */
+uint8_t encodeMorse(char c) {
+  if (c == ' ') return MORSE_CODE_WORD_SPACE;
+  if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+  if (c >= 'A' && c <= 'Z') return pgm_read_byte(&MORSE_CHARACTER_CODES.codes[c - 'A']);
+  if (c >= '0' && c <= '9') return pgm_read_byte(&MORSE_CHARACTER_CODES.codes[26 + (c - '0')]);
+  for (int i = 0; i < MORSE_PUNCTUATION_COUNT; i++) {
+    if ((char)pgm_read_byte(&MORSE_PUNCTUATION[i]) == c) return pgm_read_byte(&MORSE_PUNCTUATION_CODES.codes[i]);
+  }
+  return MORSE_CODE_NONE;
+}
+
+// =========================================================================
+// IAMBIC KEYER FUNCTIONS
+// =========================================================================
+
+/**
+ * @brief Starts a tone element (Dot or Dash) in a non-blocking way.
+ */
+void startElement(unsigned long duration, char element) {
+  halKeyOutput(true);
+  unsigned long now = halMicros();
+  if (keyer.gapScheduled) recordJitter(JIT_GAP, now - keyer.nextElementTime);
+  telemetryGap(now - keyer.keyReleaseTime, now);
+  telemetryKeyEdge(true, now);
+  telemetryElement(element, duration, now);
+  
+  decoder.append(element);
+  keyer.startElement(now, element, duration, ELEMENT_GAP, CHARACTER_GAP);
+}
+
+/**
+ * @brief Manages the non-blocking tone output and timing.
+ */
+void handleKeyerOutput() {
+  if (keyer.isKeying) {
+    unsigned long now = halMicros();
+    if (keyer.elementDue(now)) {
+      halKeyOutput(false);
+      recordJitter(keyer.keyingElement == '-' ? JIT_DASH : JIT_DOT, now - keyer.elementStopTime);
+      telemetryKeyEdge(false, now);
+      // Gaps count from the scheduled end, not this pass
+      keyer.stopElement(keyer.elementStopTime);
+      decoder.keyUp(keyer.elementStopTime, keyer.characterTime);
+    }
+  }
+}
+
+
+// =========================================================================
+// SEND QUEUE (HOST TEXT TO MORSE)
+// =========================================================================
+// Text from the host (SEND lines, WinKeyer bytes) is packed into element
+// codes once on enqueue and waits in an SRAM ring; a playing message
+// memory is streamed in ahead of it (see MESSAGE MEMORIES). Each code is
+// keyed element by element through startElement()/handleKeyerOutput(),
+// exactly like paddle elements, so loop() never blocks and playback only
+// shifts bits. The queue owns the keyer while it is active; touching a
+// paddle or the straight key aborts it (breakin).
+
+uint8_t sendQueue[SEND_QUEUE_SIZE];   // Packed element codes
+uint8_t sendHead = 0;
+uint8_t sendTail = 0;
+uint8_t sendCode = MORSE_CODE_WORD_SPACE; // Remaining elements of the character being keyed
+bool sendActive = false;              // A character is in progress or its gap has not elapsed
+bool breakinActive = false;           // Queue was aborted by the paddles/key
+bool memoryPlaying = false;           // A message memory streams in ahead of the ring
+
+void applyPendingConfig();
+void selectKeyerPass();
+uint8_t memoryNextCode();
+
+uint8_t sendQueueCount() {
+  return (sendHead - sendTail) & (SEND_QUEUE_SIZE - 1);
+}
+
+uint8_t sendQueueFree() {
+  return SEND_QUEUE_SIZE - 1 - sendQueueCount();
+}
+
+/**
+ * @brief Encodes and queues one character. Returns false if the queue is
+ *        full or the character has no Morse code.
+ */
+bool sendQueuePut(char c) {
+  uint8_t code = encodeMorse(c);
+  if (code == MORSE_CODE_NONE || sendQueueFree() == 0) return false;
+  sendQueue[sendHead] = code;
+  sendHead = (sendHead + 1) & (SEND_QUEUE_SIZE - 1);
+  return true;
+}
+
+/**
+ * @brief Removes the most recently queued character that has not started.
+ */
+void sendQueueBackspace() {
+  if (sendHead != sendTail) sendHead = (sendHead - 1) & (SEND_QUEUE_SIZE - 1);
+}
+
+bool sendQueueActive() {
+  return sendActive || sendHead != sendTail || memoryPlaying;
+}
+
+/**
+ * @brief Drops all queued text and cuts the current element short.
+ */
+void abortSendQueue() {
+  sendTail = sendHead;
+  sendCode = MORSE_CODE_WORD_SPACE;
+  sendActive = false;
+  memoryPlaying = false;
+  if (keyer.isKeying) {
+    unsigned long now = halMicros();
+    halKeyOutput(false);
+    telemetryKeyEdge(false, now);
+    keyer.stopElement(now);
+  }
+  decoder.reset(); // The interrupted character is not echoed
+  keyer.nextElementTime = halMicros();
+  keyer.gapScheduled = false;
+}
+
+/**
+ * @brief Keys the next element of queued text once its start time is reached.
+ *        Characters are separated by exactly CHARACTER_GAP and spaces add the
+ *        rest of WORD_GAP; each finished character is echoed via the decoder.
+ */
+void handleSendQueue() {
+  unsigned long now = halMicros();
+  if (keyer.isKeying || !timeReached(now, keyer.nextElementTime)) return;
+
+  if (sendCode == MORSE_CODE_WORD_SPACE) {
+    // Character (and its gap) finished: echo it and let pending settings in
+    decodeAndPrintCharacter();
+    applyPendingConfig();
+
+    if (sendHead == sendTail && !memoryPlaying) {
+      sendActive = false;
+      keyer.gapScheduled = false;
+      return;
+    }
+    sendActive = true;
+    if (memoryPlaying) {
+      sendCode = memoryNextCode();
+      if (sendCode == MORSE_CODE_NONE) {
+        sendCode = MORSE_CODE_WORD_SPACE; // Message over: the ring goes on next
+        return;
+      }
+    } else {
+      sendCode = sendQueue[sendTail];
+      sendTail = (sendTail + 1) & (SEND_QUEUE_SIZE - 1);
+    }
+
+    if (sendCode == MORSE_CODE_WORD_SPACE) {
+      printWordSpace(now);
+      keyer.nextElementTime = now + (WORD_GAP - CHARACTER_GAP);
+      return;
+    }
+  }
+
+  if (sendCode & 1) {
+    startElement(DASH_DURATION, '-');
+  } else {
+    startElement(DOT_DURATION, '.');
+  }
+  sendCode >>= 1;
+  if (sendCode == MORSE_CODE_WORD_SPACE) keyer.nextElementTime = keyer.characterTime;
+}
+
+
+// =========================================================================
+// MESSAGE MEMORIES (EEPROM)
+// =========================================================================
+// Canned messages (CQ, exchange, 73) are kept in EEPROM already encoded
+// as 2-bit symbols, four per byte from bit 0 up:
+//   0 = end of message, 1 = dot, 2 = dash, 3 = character gap
+// Every character is followed by a gap and a second gap makes a word gap,
+// so playback only shifts bits out into the send queue's scheduler and
+// looks nothing up. Layout of the 1 KB EEPROM:
+//   0..63     settings (reserved)
+//   64..1023  MEMORY_COUNT messages of MEMORY_SIZE bytes
+// A message never starts with a gap, so erased EEPROM (0xFF) reads as an
+// empty memory. New text goes out one byte per loop() pass whenever the
+// EEPROM is ready (~3.4 ms per byte); bytes that already match are skipped.
+// The button on MEMORY_BUTTON_PIN plays memory n when pressed n times in a
+// row; a press while text is being sent stops it.
+
+const uint16_t MEMORY_BASE = EEPROM_SETTINGS_SIZE;
+const uint16_t MEMORY_SYMBOLS = MEMORY_SIZE * 4;
+const uint8_t SYMBOL_END = 0;
+const uint8_t SYMBOL_DOT = 1;
+const uint8_t SYMBOL_DASH = 2;
+const uint8_t SYMBOL_GAP = 3;
+const uint8_t MEMORY_CHARACTER_SYMBOLS = 10; // Room checked per character: gaps, elements, end
+// One command line of text, at most a word gap and a five-element
+// character per input character
+const uint8_t MEMORY_WRITE_SIZE = (COMMAND_LINE_SIZE * 7 + 8) / 4;
+
+static_assert(MEMORY_BASE + MEMORY_COUNT * MEMORY_SIZE <= EEPROM_BYTES, "Message memories do not fit the EEPROM");
+
+uint8_t memoryWriteBuffer[MEMORY_WRITE_SIZE];
+uint16_t memoryWriteAddress = 0;      // EEPROM address of memoryWriteBuffer[0]
+uint8_t memoryWriteLength = 0;        // Bytes in memoryWriteBuffer
+uint8_t memoryWriteIndex = 0;         // Next byte to write; == memoryWriteLength when idle
+uint16_t memoryPlayAddress = 0;       // Next EEPROM byte of the playing memory
+uint16_t memoryPlayEnd = 0;
+uint8_t memoryPlayBits = 0;           // Symbols of the current byte, next one in bits 0..1
+uint8_t memoryPlayCount = 0;          // Symbols left in memoryPlayBits
+bool memoryButtonRaw = false;         // Button contact on the last pass
+bool memoryButtonDown = false;        // Debounced button state
+unsigned long memoryButtonChangedTime = 0; // halMillis() of the last contact change
+uint8_t memoryButtonPresses = 0;      // Presses in the current run
+
+/**
+ * @brief True until the last byte's write has finished, not just started:
+ *        any EEPROM read before then would wait for it.
+ */
+bool memoryWriting() {
+  return memoryWriteIndex != memoryWriteLength || !halEepromReady();
+}
+
+uint16_t memoryAddress(uint8_t slot) {
+  return MEMORY_BASE + slot * MEMORY_SIZE;
+}
+
+/**
+ * @brief Reads one symbol of a memory (slot 0-based) from the EEPROM.
+ */
+uint8_t memorySymbol(uint8_t slot, uint16_t index) {
+  return (halEepromRead(memoryAddress(slot) + index / 4) >> (2 * (index % 4))) & 3;
+}
+
+/**
+ * @brief True if the memory starts with an element; erased EEPROM does not.
+ */
+bool memoryHasMessage(uint8_t slot) {
+  uint8_t symbol = memorySymbol(slot, 0);
+  return symbol == SYMBOL_DOT || symbol == SYMBOL_DASH;
+}
+
+/**
+ * @brief Puts one symbol into the write buffer, index counted from the
+ *        first symbol of memoryWriteBuffer[0].
+ */
+void memoryBufferSymbol(uint16_t index, uint8_t symbol) {
+  uint8_t shift = 2 * (index % 4);
+  uint8_t* byte = &memoryWriteBuffer[index / 4];
+  *byte = (*byte & ~(3 << shift)) | (symbol << shift);
+}
+
+/**
+ * @brief Encodes text for a memory, replacing it or, with append,
+ *        continuing it after a word gap, and hands it to the writer.
+ *        Returns false, and leaves the memory alone, if a character has no
+ *        Morse code or the text does not fit.
+ */
+bool memoryStore(uint8_t slot, const char* text, bool append) {
+  uint16_t position = 0;  // Symbol index in the memory
+  if (append && memoryHasMessage(slot)) {
+    while (position < MEMORY_SYMBOLS && memorySymbol(slot, position) != SYMBOL_END) position++;
+  }
+  uint16_t first = position & ~3;  // Memory symbol held in bits 0..1 of memoryWriteBuffer[0]
+  memoryWriteBuffer[0] = halEepromRead(memoryAddress(slot) + first / 4); // Keeps the symbols before position
+  bool gapDue = position > 0;
+
+  for (; *text != '\0'; text++) {
+    uint8_t code = encodeMorse(*text);
+    if (code == MORSE_CODE_NONE) return false;
+    if (code == MORSE_CODE_WORD_SPACE) {
+      gapDue = position > 0;
+      continue;
+    }
+    if (position + MEMORY_CHARACTER_SYMBOLS > MEMORY_SYMBOLS ||
+        position - first + MEMORY_CHARACTER_SYMBOLS > MEMORY_WRITE_SIZE * 4) {
+      return false;
+    }
+    if (gapDue) memoryBufferSymbol(position++ - first, SYMBOL_GAP);
+    gapDue = false;
+    for (; code != MORSE_CODE_WORD_SPACE; code >>= 1) {
+      memoryBufferSymbol(position++ - first, (code & 1) ? SYMBOL_DASH : SYMBOL_DOT);
+    }
+    memoryBufferSymbol(position++ - first, SYMBOL_GAP);
+  }
+  memoryBufferSymbol(position++ - first, SYMBOL_END);
+
+  memoryWriteAddress = memoryAddress(slot) + first / 4;
+  memoryWriteLength = (position - first + 3) / 4;
+  memoryWriteIndex = 0;
+  return true;
+}
+
+/**
+ * @brief Writes the next changed byte once the EEPROM is ready. Costs one
+ *        compare while nothing is pending.
+ */
+void handleMemoryWriter() {
+  if (memoryWriteIndex == memoryWriteLength || !halEepromReady()) return;
+  uint16_t address = memoryWriteAddress + memoryWriteIndex;
+  uint8_t value = memoryWriteBuffer[memoryWriteIndex++];
+  if (halEepromRead(address) != value) halEepromWrite(address, value);
+}
+
+/**
+ * @brief Prints "MEM n text" for a memory, decoded from its symbols.
+ */
+void memoryPrint(uint8_t slot) {
+  txPrint("MEM ");
+  txPrint((unsigned long)(slot + 1));
+  txPrint(' ');
+  DecoderState text;
+  text.reset();
+  uint16_t length = memoryHasMessage(slot) ? MEMORY_SYMBOLS : 0;
+  for (uint16_t i = 0; i < length; i++) {
+    uint8_t symbol = memorySymbol(slot, i);
+    if (symbol == SYMBOL_END) break;
+    if (symbol != SYMBOL_GAP) {
+      text.append(symbol == SYMBOL_DASH ? '-' : '.');
+    } else if (text.length > 0) {
+      txPrint(text.take());
+    } else {
+      txPrint(' ');
+    }
+  }
+  txPrintln();
+}
+
+/**
+ * @brief Starts sending a memory through the send queue. Returns false if
+ *        it is empty or the queue or the EEPROM writer is busy.
+ */
+bool memoryPlay(uint8_t slot) {
+  if (slot >= MEMORY_COUNT || memoryWriting() || sendQueueActive() || !memoryHasMessage(slot)) return false;
+  memoryPlayAddress = memoryAddress(slot);
+  memoryPlayEnd = memoryPlayAddress + MEMORY_SIZE;
+  memoryPlayCount = 0;
+  memoryPlaying = true;
+  return true;
+}
+
+uint8_t memoryNextSymbol() {
+  if (memoryPlayCount == 0) {
+    if (memoryPlayAddress == memoryPlayEnd) return SYMBOL_END;
+    memoryPlayBits = halEepromRead(memoryPlayAddress++);
+    memoryPlayCount = 4;
+  }
+  uint8_t symbol = memoryPlayBits & 3;
+  memoryPlayBits >>= 2;
+  memoryPlayCount--;
+  return symbol;
+}
+
+/**
+ * @brief Collects the playing memory's next character into a packed
+ *        element code: MORSE_CODE_WORD_SPACE for the second gap of a word
+ *        gap, MORSE_CODE_NONE once the message is over.
+ */
+uint8_t memoryNextCode() {
+  uint8_t code = 0;
+  uint8_t length = 0;
+  for (;;) {
+    uint8_t symbol = memoryNextSymbol();
+    if (symbol == SYMBOL_GAP) return code | (1 << length);
+    if (symbol == SYMBOL_END) break;
+    if (length < MAX_SEQUENCE_LENGTH) {
+      if (symbol == SYMBOL_DASH) code |= 1 << length;
+      length++;
+    }
+  }
+  memoryPlaying = false;
+  return length > 0 ? code | (1 << length) : MORSE_CODE_NONE;
+}
+
+/**
+ * @brief Debounces the memory button and plays memory n after a run of n
+ *        presses. Costs three compares while the button is untouched.
+ */
+void handleMemoryButton(uint8_t keys) {
+  bool down = keys & KEY_MEMORY;
+  if (down != memoryButtonRaw) {
+    memoryButtonRaw = down;
+    memoryButtonChangedTime = halMillis();
+    return;
+  }
+  if (down != memoryButtonDown) {
+    if (!timeReached(halMillis(), memoryButtonChangedTime + MEMORY_BUTTON_DEBOUNCE_MS)) return;
+    memoryButtonDown = down;
+    if (!down) return;
+    if (sendQueueActive()) {
+      abortSendQueue();
+      memoryButtonPresses = 0;
+    } else if (memoryButtonPresses <= MEMORY_COUNT) {
+      memoryButtonPresses++;
+    }
+    return;
+  }
+  if (memoryButtonPresses == 0 || down) return;
+  if (!timeReached(halMillis(), memoryButtonChangedTime + MEMORY_BUTTON_SELECT_MS)) return;
+  memoryPlay(memoryButtonPresses - 1);
+  memoryButtonPresses = 0;
+}
+
+
+// =========================================================================
+// STRAIGHT KEY HELPER FUNCTIONS
+// =========================================================================
+
+void handleKeyPress() {
+  unsigned long now = halMicros();
+  keyer.keyDown(now);
+  halKeyOutput(true);
+  telemetryGap(now - keyer.keyReleaseTime, now);
+  telemetryKeyEdge(true, now);
+}
+
+void handleKeyRelease() {
+  unsigned long now = halMicros();
+  unsigned long keyPressDuration = keyer.keyUp(now);
+  halKeyOutput(false);
+  decoder.keyUp(now, now + CHARACTER_GAP);
+  telemetryKeyEdge(false, now);
+
+  // Determine if the press was a dot or a dash based on dynamic timing ratios
+  char element = classifyPress(keyPressDuration, DOT_DURATION);
+  if (element != '\0') {
+    decoder.append(element);
+    telemetryElement(element, keyPressDuration, now);
+  }
+}
+
+
+// =========================================================================
+// HOST COMMANDS
+// =========================================================================
+// The host sends CR/LF terminated lines. Input is collected into a fixed
+// buffer without blocking and handled once the line is complete.
+//
+// Baud rate negotiation:
+//   host:   BAUD 115200          (also 500000, 1000000 or 9600)
+//   device: OK BAUD 115200       (still at the old rate, then switches)
+//   host:   BAUD OK              (at the new rate, within BAUD_CONFIRM_MS)
+//   device: BAUD LOCKED 115200
+// Without confirmation the device returns to the previous rate. A burst
+// of framing errors (terminal at the wrong rate) forces SAFE_BAUD, and a
+// reset always starts at SAFE_BAUD.
+//
+// Keyer configuration (acknowledged at once, applied at the next
+// character boundary so an element or character is never cut short):
+//   MODE STRAIGHT | IAMBIC_A | IAMBIC_B | ULTIMATIC | SINGLE_LEVER | BUG
+//        | COOTIE | AUTO (paddles and straight key)
+//        Only with KEYER_RUNTIME_MODES 1; ERR otherwise
+//   PADMEM DOT | DASH | BOTH | OFF - paddle memory (see KEYING STYLES in keyer.h)
+//   AUTOSPACE ON | OFF - paddle character spacing (see KEYING STYLES in keyer.h)
+//   WPM 22       - fixed character speed, WPM POT returns to the pot
+//   TONE 700     - sidetone in Hz (MIN_TONE_FREQ..MAX_TONE_FREQ)
+//   FARNS 18/10  - 18 WPM characters spaced out to 10 WPM, FARNS OFF
+//   TLM ON | OFF - binary telemetry
+//   STAMP ON | OFF, LAT, LAT RESET - decode latency (see DECODE LATENCY TIMESTAMPS)
+//
+// Text sending (see SEND QUEUE):
+//   SEND CQ DE TEST - letters, digits, punctuation and spaces keyed at the
+//                     current speed; ERR SEND if a character has no code
+//                     or the line does not fit in the queue. Lines are
+//                     queued back to back, so end a line with a space to
+//                     keep words apart. A paddle or key touch clears the
+//                     queue.
+//
+// Message memories 1..6 (see MESSAGE MEMORIES):
+//   MEM 1 CQ CQ DE TEST - store a message, MEM 1 alone prints it back
+//   MEMADD 1 TEST K     - continue it after a word gap
+//   PLAY 1              - send it; ERR PLAY if empty or text is being sent
+
+enum BaudState {
+  BAUD_STABLE,
+  BAUD_DRAINING,   // Reply queued at the old rate, waiting for it to go out
+  BAUD_CONFIRMING  // Running at the new rate, waiting for "BAUD OK"
+};
+
+char commandLine[COMMAND_LINE_SIZE];
+uint8_t commandLength = 0;
+bool commandOverflow = false;
+BaudState baudState = BAUD_STABLE;
+unsigned long pendingBaud = 0;
+unsigned long confirmedBaud = SAFE_BAUD;
+unsigned long baudDeadline = 0;       // halMillis() deadline for the host confirmation
+
+// Settings received over serial, waiting for a character boundary
+enum ConfigChange {
+  CFG_MODE = 1,
+  CFG_SPEED = 2,
+  CFG_POT = 4,
+  CFG_TONE = 8,
+  CFG_FARNSWORTH = 16,
+  CFG_MEMORY = 32,
+  CFG_AUTOSPACE = 64
+};
+
+struct PendingConfig {
+  uint8_t changes;         // ConfigChange bits
+  bool iambic;
+  bool straight;
+  KeyerMode iambicMode;
+  uint8_t memory;          // PaddleMemory bits
+  bool autospace;
+  int wpm;
+  unsigned int tone;
+  int farnsworthWPM;
+};
+PendingConfig pendingConfig = { 0, false, false, MODE_A, MEMORY_OFF, false, 0, 0, 0 };
+
+/**
+ * @brief Returns true for the rates the device is willing to switch to.
+ */
+bool isSupportedBaud(unsigned long baud) {
+  return baud == 9600 || baud == 115200 || baud == 500000 || baud == 1000000;
+}
+
+/**
+ * @brief Returns the text after "NAME " if the line starts with it, otherwise NULL.
+ */
+const char* commandArgument(const char* line, const char* name) {
+  size_t length = strlen(name);
+  if (strncmp(line, name, length) != 0 || line[length] != ' ') return NULL;
+  return line + length + 1;
+}
+
+/**
+ * @brief Parses a decimal number in [minimum, maximum]. Returns a pointer
+ *        past the digits, or NULL if there are none or the value is out of range.
+ */
+const char* parseNumber(const char* text, long minimum, long maximum, int* value) {
+  char* end;
+  long parsed = strtol(text, &end, 10);
+  if (end == text || parsed < minimum || parsed > maximum) return NULL;
+  *value = (int)parsed;
+  return end;
+}
+
+/**
+ * @brief Handles MODE, PADMEM, AUTOSPACE, WPM, TONE and FARNS. Returns false
+ *        if the line is not a configuration command or its argument is invalid.
+ */
+bool handleConfigCommand(const char* line) {
+  const char* argument;
+  const char* end;
+  int value;
+
+  if ((argument = commandArgument(line, "MODE")) != NULL) {
+    if (!KEYER_RUNTIME_MODES) return false; // Only the built-in style is compiled
+    if (!(pendingConfig.changes & CFG_MODE)) pendingConfig.iambicMode = currentIambicMode;
+    if (strcmp(argument, "STRAIGHT") == 0) {
+      pendingConfig.iambic = false;
+      pendingConfig.straight = true;
+    } else if (strcmp(argument, "AUTO") == 0) {
+      pendingConfig.iambic = true;   // Paddles keep the current style
+      pendingConfig.straight = true;
+    } else {
+      uint8_t mode = 0;
+      while (mode < PADDLE_MODE_COUNT && strcmp(argument, PADDLE_MODE_NAMES[mode]) != 0) mode++;
+      if (mode == PADDLE_MODE_COUNT) return false;
+      pendingConfig.iambic = true;
+      pendingConfig.straight = false;
+      pendingConfig.iambicMode = (KeyerMode)mode;
+    }
+    pendingConfig.changes |= CFG_MODE;
+  } else if ((argument = commandArgument(line, "PADMEM")) != NULL) {
+    if (strcmp(argument, "DOT") == 0) {
+      pendingConfig.memory = MEMORY_DOT;
+    } else if (strcmp(argument, "DASH") == 0) {
+      pendingConfig.memory = MEMORY_DASH;
+    } else if (strcmp(argument, "BOTH") == 0) {
+      pendingConfig.memory = MEMORY_BOTH;
+    } else if (strcmp(argument, "OFF") == 0) {
+      pendingConfig.memory = MEMORY_OFF;
+    } else {
+      return false;
+    }
+    pendingConfig.changes |= CFG_MEMORY;
+  } else if ((argument = commandArgument(line, "AUTOSPACE")) != NULL) {
+    if (strcmp(argument, "ON") == 0) {
+      pendingConfig.autospace = true;
+    } else if (strcmp(argument, "OFF") == 0) {
+      pendingConfig.autospace = false;
+    } else {
+      return false;
+    }
+    pendingConfig.changes |= CFG_AUTOSPACE;
+  } else if ((argument = commandArgument(line, "WPM")) != NULL) {
+    if (strcmp(argument, "POT") == 0) {
+      pendingConfig.changes = (pendingConfig.changes & ~CFG_SPEED) | CFG_POT;
+    } else {
+      end = parseNumber(argument, MIN_WPM, MAX_WPM, &value);
+      if (end == NULL || *end != '\0') return false;
+      pendingConfig.wpm = value;
+      pendingConfig.changes = (pendingConfig.changes & ~CFG_POT) | CFG_SPEED;
+    }
+  } else if ((argument = commandArgument(line, "TONE")) != NULL) {
+    end = parseNumber(argument, MIN_TONE_FREQ, MAX_TONE_FREQ, &value);
+    if (end == NULL || *end != '\0') return false;
+    pendingConfig.tone = value;
+    pendingConfig.changes |= CFG_TONE;
+  } else if ((argument = commandArgument(line, "FARNS")) != NULL) {
+    if (strcmp(argument, "OFF") == 0) {
+      pendingConfig.farnsworthWPM = 0;
+    } else {
+      end = parseNumber(argument, MIN_WPM, MAX_WPM, &value);
+      if (end == NULL || *end != '/') return false;
+      int characterWPM = value;
+      end = parseNumber(end + 1, MIN_WPM, characterWPM, &value);
+      if (end == NULL || *end != '\0') return false;
+      pendingConfig.wpm = characterWPM;
+      pendingConfig.farnsworthWPM = value;
+      pendingConfig.changes = (pendingConfig.changes & ~CFG_POT) | CFG_SPEED;
+    }
+    pendingConfig.changes |= CFG_FARNSWORTH;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Applies configuration received over serial once no element or
+ *        character is in progress.
+ */
+void applyPendingConfig() {
+  if (pendingConfig.changes == 0) return;
+  if (keyer.isKeying || keyer.keyWasPressed || decoder.length > 0) return;
+
+  uint8_t changes = pendingConfig.changes;
+  pendingConfig.changes = 0;
+
+  if (changes & CFG_MODE) {
+    iambicModeActive = pendingConfig.iambic;
+    straightKeyModeActive = pendingConfig.straight;
+    currentIambicMode = pendingConfig.iambicMode;
+    keyer.squeezeMemory = false;
+    selectKeyerPass();
+  }
+  if (changes & CFG_MEMORY) {
+    keyer.memoryEnabled = pendingConfig.memory;
+    keyer.memoryArmed = 0;
+    keyer.paddleMemory = 0;
+  }
+  if (changes & CFG_AUTOSPACE) {
+    keyer.autospace = pendingConfig.autospace;
+  }
+  if (changes & CFG_TONE) {
+    toneFrequency = pendingConfig.tone;
+    halSidetoneFrequency(toneFrequency);
+  }
+  if (changes & CFG_FARNSWORTH) {
+    farnsworthWPM = pendingConfig.farnsworthWPM;
+  }
+  if (changes & CFG_POT) {
+    speedFromCommand = false;
+    lastPotReading = -POT_HYSTERESIS - 1; // Take the next reading unconditionally
+  } else if (changes & CFG_SPEED) {
+    speedFromCommand = true;
+    setSpeed(pendingConfig.wpm);
+  } else if (changes & CFG_FARNSWORTH) {
+    setSpeed(currentWPM);
+  }
+}
+
+/**
+ * @brief Executes one complete command line.
+ */
+void handleCommand(char* line) {
+  const char* argument;
+
+  if (strcmp(line, "BAUD OK") == 0) {
+    if (baudState == BAUD_CONFIRMING) {
+      baudState = BAUD_STABLE;
+      confirmedBaud = currentBaud;
+      txPrint("BAUD LOCKED ");
+      txPrint(currentBaud);
+      txPrintln();
+    }
+  } else if (strcmp(line, "TLM ON") == 0) {
+    txPrintln("OK TLM ON");
+    lastTelemetryTime = halMicros();
+    telemetryEnabled = true;
+  } else if (strcmp(line, "TLM OFF") == 0) {
+    telemetryEnabled = false;
+    txPrintln("OK TLM OFF");
+  } else if ((argument = commandArgument(line, "BAUD")) != NULL) {
+    unsigned long baud = strtoul(argument, NULL, 10);
+    if (!isSupportedBaud(baud) || baudState != BAUD_STABLE) {
+      txPrintln("ERR BAUD");
+      return;
+    }
+    txPrint("OK BAUD ");
+    txPrint(baud);
+    txPrintln();
+    pendingBaud = baud;
+    baudState = BAUD_DRAINING;
+  } else if (strcmp(line, "STAMP ON") == 0) {
+    txPrintln("OK STAMP ON");
+    stampMode = true;
+  } else if (strcmp(line, "STAMP OFF") == 0) {
+    stampMode = false;
+    txPrintln("OK STAMP OFF");
+  } else if (strcmp(line, "LAT") == 0) {
+    printLatency();
+  } else if (strcmp(line, "LAT RESET") == 0) {
+    resetLatency();
+    txPrintln("OK LAT RESET");
+  } else if (strcmp(line, "JIT") == 0) {
+    jitterDumpLine = 0;
+  } else if (strcmp(line, "JIT RESET") == 0) {
+    resetJitter();
+    txPrintln("OK JIT RESET");
+#if PROFILE_ENABLED
+  } else if (strcmp(line, "PROF") == 0) {
+    profileDumpLine = 0;
+  } else if (strcmp(line, "PROF RESET") == 0) {
+    resetProfile();
+    txPrintln("OK PROF RESET");
+#endif
+  } else if ((argument = commandArgument(line, "SEND")) != NULL) {
+    // All or nothing, so the host can simply retry the line later
+    const char* c = argument;
+    while (*c != '\0' && encodeMorse(*c) != MORSE_CODE_NONE) c++;
+    if (*c != '\0' || (size_t)(c - argument) > sendQueueFree()) {
+      txPrintln("ERR SEND");
+      return;
+    }
+    for (c = argument; *c != '\0'; c++) sendQueuePut(*c);
+    txPrintln("OK SEND");
+  } else if ((argument = commandArgument(line, "PLAY")) != NULL) {
+    int number;
+    const char* end = parseNumber(argument, 1, MEMORY_COUNT, &number);
+    if (end == NULL || *end != '\0' || !memoryPlay(number - 1)) {
+      txPrintln("ERR PLAY");
+      return;
+    }
+    txPrint("OK ");
+    txPrintln(line);
+  } else if ((argument = commandArgument(line, "MEM")) != NULL ||
+             (argument = commandArgument(line, "MEMADD")) != NULL) {
+    // Never while the EEPROM is busy or a memory plays: reads would stall
+    bool append = line[3] == 'A';
+    int number;
+    const char* text = parseNumber(argument, 1, MEMORY_COUNT, &number);
+    if (text == NULL || memoryWriting() || memoryPlaying || (*text != ' ' && (*text != '\0' || append))) {
+      txPrintln(append ? "ERR MEMADD" : "ERR MEM");
+      return;
+    }
+    if (*text == '\0') {
+      memoryPrint(number - 1);
+      return;
+    }
+    if (!memoryStore(number - 1, text + 1, append)) {
+      txPrintln(append ? "ERR MEMADD" : "ERR MEM");
+      return;
+    }
+    txPrint("OK ");
+    txPrintln(line);
+  } else if (strcmp(line, "WK") == 0) {
+    // Answer at the current rate, then switch once the reply has gone out
+    txPrintln("OK WK");
+    winkeyerMode = true;
+    pendingBaud = WINKEYER_BAUD;
+    baudState = BAUD_DRAINING;
+    confirmedBaud = WINKEYER_BAUD;
+  } else if (handleConfigCommand(line)) {
+    txPrint("OK ");
+    txPrintln(line);
+  } else {
+    txPrint("ERR ");
+    txPrintln(line);
+  }
+}
+
+/**
+ * @brief Collects received bytes into commandLine and dispatches full lines.
+ */
+void handleSerialInput() {
+  int c;
+  while ((c = rxRead()) >= 0) {
+    if (winkeyerMode) {
+      handleWinkeyerByte((uint8_t)c);
+    } else if (c == '\r' || c == '\n') {
+      if (commandLength > 0 && !commandOverflow) {
+        commandLine[commandLength] = '\0';
+        handleCommand(commandLine);
+      }
+      commandLength = 0;
+      commandOverflow = false;
+    } else if (commandLength < COMMAND_LINE_SIZE - 1) {
+      commandLine[commandLength++] = (char)c;
+    } else {
+      commandOverflow = true; // Discard the whole over-long line
+    }
+  }
+}
+
+/**
+ * @brief Advances the baud rate negotiation and the framing-error fallback.
+ */
+void handleBaudChange() {
+  if (baudState == BAUD_DRAINING) {
+    if (!serialIdle()) return;
+    serialBegin(pendingBaud);
+    baudState = winkeyerMode ? BAUD_STABLE : BAUD_CONFIRMING; // WinKeyer hosts never confirm
+    baudDeadline = halMillis() + BAUD_CONFIRM_MS;
+  } else if (baudState == BAUD_CONFIRMING) {
+    if (!timeReached(halMillis(), baudDeadline)) return;
+    serialBegin(confirmedBaud);
+    baudState = BAUD_STABLE;
+    txPrint("BAUD FALLBACK ");
+    txPrint(confirmedBaud);
+    txPrintln();
+  } else if (rxFramingErrors >= BAUD_FALLBACK_ERRORS && currentBaud != SAFE_BAUD && !winkeyerMode) {
+    serialBegin(SAFE_BAUD);
+    confirmedBaud = SAFE_BAUD;
+    txPrint("BAUD FALLBACK ");
+    txPrint(SAFE_BAUD);
+    txPrintln();
+  }
+}
+
+// =========================================================================
+// WINKEYER HOST PROTOCOL
+// =========================================================================
+// A subset of the K1EL WinKeyer 2 binary protocol at 1200 baud, enough for
+// logging and contest programs to use the trainer as a hardware keyer:
+//   0x00 0x02 / 0x00 0x03   host open (answered with WINKEYER_VERSION) / close
+//   0x00 0x04 nn            echo test
+//   0x02 nn                 set speed (0 = speed pot)
+//   0x07                    read speed pot (answered 0x80 | pot offset)
+//   0x08                    backspace the send buffer
+//   0x0A                    clear the send buffer
+//   0x15                    request status
+//   0x20..0x7F              text to send: letters (either case), digits,
+//                           MORSE_PUNCTUATION and the prosign keys < > [ ] \
+// Other commands are accepted and their arguments skipped, and so are the
+// few printable bytes without Morse code (# % * ^ ` { | } ~), as on a
+// WinKeyer. While the host is open, status bytes are sent whenever they
+// change: 0xC0 | BUSY (0x04), BREAKIN (0x02), XOFF (0x01); the WAIT and
+// KEYDOWN bits are never set. Pot changes are sent as 0x80 | offset, and
+// every character sent or keyed on the paddles is echoed as ASCII (a
+// prosign key as the punctuation mark it shares its pattern with).
+
+// Argument bytes that follow each command 0x00..0x1F
+const uint8_t WINKEYER_ARGUMENTS[32] = {
+  1, 1, 1, 1, 2, 3, 1, 0, 0, 1, 0, 1, 1, 1, 1, 15,
+  1, 1, 1, 0, 1, 0, 1, 1, 1, 1, 1, 2, 1, 1, 0, 0
+};
+const uint8_t WK_STATUS = 0xC0;
+const uint8_t WK_STATUS_XOFF = 0x01;
+const uint8_t WK_STATUS_BREAKIN = 0x02;
+const uint8_t WK_STATUS_BUSY = 0x04;
+
+bool winkeyerHostOpen = false;
+uint8_t winkeyerCommand = 0;
+uint8_t winkeyerArgumentsNeeded = 0;  // 0 = next byte starts a new command
+uint8_t winkeyerArguments[2];
+uint8_t winkeyerArgumentCount = 0;
+uint8_t winkeyerLastStatus = WK_STATUS;
+
+bool winkeyerActive() {
+  return winkeyerMode && winkeyerHostOpen;
+}
+
+uint8_t winkeyerPotOffset() {
+  int potWPM = (lastPotReading >= 0) ? potToWPM(lastPotReading) : currentWPM;
+  return (uint8_t)(potWPM - MIN_WPM) & 0x3F;
+}
+
+/**
+ * @brief Sends a pot change to an open host.
+ */
+void winkeyerReportPot() {
+  if (winkeyerActive()) txPrint((char)(0x80 | winkeyerPotOffset()));
+}
+
+uint8_t winkeyerStatus() {
+  uint8_t status = WK_STATUS;
+  if (sendQueueCount() > SEND_QUEUE_SIZE * 2 / 3) status |= WK_STATUS_XOFF;
+  if (breakinActive) status |= WK_STATUS_BREAKIN;
+  if (sendQueueActive()) status |= WK_STATUS_BUSY;
+  return status;
+}
+
+/**
+ * @brief Executes a command once all of its argument bytes have arrived.
+ */
+void executeWinkeyerCommand() {
+  switch (winkeyerCommand) {
+    case 0x00: // Admin
+      if (winkeyerArguments[0] == 0x02) {
+        winkeyerHostOpen = true;
+        winkeyerLastStatus = WK_STATUS;
+        txPrint((char)WINKEYER_VERSION);
+      } else if (winkeyerArguments[0] == 0x03) {
+        winkeyerHostOpen = false;
+      } else if (winkeyerArguments[0] == 0x04) {
+        txPrint((char)winkeyerArguments[1]);
+      }
+      break;
+    case 0x02: // Set speed
+      if (winkeyerArguments[0] == 0) {
+        pendingConfig.changes = (pendingConfig.changes & ~CFG_SPEED) | CFG_POT;
+      } else {
+        int wpm = winkeyerArguments[0];
+        pendingConfig.wpm = (wpm < MIN_WPM) ? MIN_WPM : (wpm > MAX_WPM) ? MAX_WPM : wpm;
+        pendingConfig.changes = (pendingConfig.changes & ~CFG_POT) | CFG_SPEED;
+      }
+      break;
+    case 0x07: // Get speed pot
+      txPrint((char)(0x80 | winkeyerPotOffset()));
+      break;
+    case 0x08: // Backspace
+      sendQueueBackspace();
+      break;
+    case 0x0A: // Clear buffer
+      abortSendQueue();
+      break;
+    case 0x15: // Request status
+      txPrint((char)winkeyerStatus());
+      break;
+  }
+}
+
+/**
+ * @brief Feeds one received byte to the WinKeyer command parser.
+ */
+void handleWinkeyerByte(uint8_t data) {
+  if (winkeyerArgumentsNeeded > 0) {
+    if (winkeyerArgumentCount < sizeof(winkeyerArguments)) {
+      winkeyerArguments[winkeyerArgumentCount] = data;
+    }
+    winkeyerArgumentCount++;
+    winkeyerArgumentsNeeded--;
+    // Admin echo (0x00 0x04) carries one more byte
+    if (winkeyerCommand == 0x00 && winkeyerArgumentCount == 1 && data == 0x04) {
+      winkeyerArgumentsNeeded = 1;
+    }
+    if (winkeyerArgumentsNeeded == 0) executeWinkeyerCommand();
+    return;
+  }
+
+  if (data < 0x20) {
+    winkeyerCommand = data;
+    winkeyerArgumentCount = 0;
+    winkeyerArgumentsNeeded = WINKEYER_ARGUMENTS[data];
+    if (winkeyerArgumentsNeeded == 0) executeWinkeyerCommand();
+  } else if (data < 0x80) {
+    if (data >= 'a' && data <= 'z') data -= 'a' - 'A';
+    sendQueuePut((char)data);
+  }
+}
+
+/**
+ * @brief Sends the status byte to an open host whenever it changes.
+ */
+void handleWinkeyerStatus() {
+  if (!winkeyerActive()) return;
+  uint8_t status = winkeyerStatus();
+  if (status != winkeyerLastStatus) {
+    winkeyerLastStatus = status;
+    txPrint((char)status);
+  }
+}
+
+// =========================================================================
+// KEYER PASS
+// =========================================================================
+// Everything loop() does with the keys once they are read, specialised per
+// keying style (see KEYING STYLES in keyer.h): the style is a template
+// argument, so each instance contains only its own path.
+
+// Contacts a style keys by hand; the other paddle contacts run the element
+// scheduler
+template <class Style>
+struct ManualKeys {
+  static const uint8_t MASK = !Style::PADDLES ? KEY_STRAIGHT
+      : (uint8_t)((Style::MANUAL_DOT ? KEY_DOT : 0) | (Style::MANUAL_DASH ? KEY_DASH : 0));
+};
+
+#if KEYER_RUNTIME_MODES
+// The style in use, as data: selectKeyerPass() copies a policy in at a
+// character boundary and keyerPass<ActiveStyle> reads it on every pass.
+// Same members as the policies in keyer.h.
+struct ActiveStyle {
+  static bool PADDLES;
+  static SqueezeRule SQUEEZE;
+  static bool SQUEEZE_MEMORY;
+  static bool MANUAL_DOT;
+  static bool MANUAL_DASH;
+};
+bool ActiveStyle::PADDLES = false;
+SqueezeRule ActiveStyle::SQUEEZE = SQUEEZE_ALTERNATE;
+bool ActiveStyle::SQUEEZE_MEMORY = false;
+bool ActiveStyle::MANUAL_DOT = false;
+bool ActiveStyle::MANUAL_DASH = false;
+
+template <>
+struct ManualKeys<ActiveStyle> {
+  static uint8_t MASK;
+};
+uint8_t ManualKeys<ActiveStyle>::MASK = KEY_STRAIGHT;
+
+template <class Policy>
+void loadStyle() {
+  ActiveStyle::PADDLES = Policy::PADDLES;
+  ActiveStyle::SQUEEZE = Policy::SQUEEZE;
+  ActiveStyle::SQUEEZE_MEMORY = Policy::SQUEEZE_MEMORY;
+  ActiveStyle::MANUAL_DOT = Policy::MANUAL_DOT;
+  ActiveStyle::MANUAL_DASH = Policy::MANUAL_DASH;
+  ManualKeys<ActiveStyle>::MASK = ManualKeys<Policy>::MASK;
+}
+#endif
+
+template <class Style>
+void keyerPass(uint8_t keys) {
+  const uint8_t manualKeys = ManualKeys<Style>::MASK;
+  const uint8_t automaticKeys = Style::PADDLES ? KEY_PADDLES & ~manualKeys : 0;
+  bool dotPaddleState = keys & KEY_DOT & automaticKeys;
+  bool dashPaddleState = keys & KEY_DASH & automaticKeys;
+  bool manualKeyDown = keys & manualKeys;
+  bool inputTouched = keys & (manualKeys | automaticKeys);
+
+  // Host text owns the keyer until it is done or the operator breaks in
+  if (sendQueueActive()) {
+    if (!inputTouched) {
+      PROFILE_BEGIN(PROF_KEYER);
+      handleSendQueue();
+      PROFILE_END(PROF_KEYER);
+      handleWinkeyerStatus();
+      return;
+    }
+    abortSendQueue();
+    breakinActive = true;
+  } else if (breakinActive && !inputTouched && !keyer.isKeying && decoder.length == 0) {
+    breakinActive = false;
+  }
+  handleWinkeyerStatus();
+
+  // --- Iambic Keyer Logic (paddles, bug dots) ---
+  // A hand-keyed element in progress holds the scheduler off; both tests
+  // fold away for styles without hand-keyed contacts
+  if (automaticKeys) {
+
+    // DECODE: Character/Word Detection (only check if we are NOT currently sending an element)
+    if (!keyer.isKeying && (!manualKeys || !keyer.keyWasPressed)) {
+      PROFILE_BEGIN(PROF_DECODE);
+      handleDecoder();
+      PROFILE_END(PROF_DECODE);
+    }
+
+    // KEYER LOGIC: Only start a new element if timing is met (halMicros() past nextElementTime)
+    if (!manualKeys || !keyer.keyWasPressed) {
+      PROFILE_BEGIN(PROF_KEYER);
+      char element = keyer.iambicNext<Style>(halMicros(), dotPaddleState, dashPaddleState, keys & KEY_SQUEEZE);
+      if (element == '-') {
+        startElement(DASH_DURATION, '-');
+      } else if (element == '.') {
+        startElement(DOT_DURATION, '.');
+      }
+      PROFILE_END(PROF_KEYER);
+    }
+    if (!manualKeys) return;
+  }
+
+  // --- Straight Key Logic (straight key, bug dashes, cootie) ---
+  if (!manualKeyDown && keyer.keyWasPressed) {
+    PROFILE_BEGIN(PROF_KEYER);
+    handleKeyRelease();
+    // Bug: an automatic dot keeps an element gap after a hand-keyed element
+    if (automaticKeys) keyer.nextElementTime = keyer.keyReleaseTime + ELEMENT_GAP;
+    PROFILE_END(PROF_KEYER);
+  }
+
+  // Character/Word Detection (Uses time since last release); polled above
+  // when automatic elements share the decoder. Also runs on the pass that
+  // sees a new press, so a press exactly one character gap after the last
+  // release starts a new character.
+  if (!automaticKeys && !keyer.keyWasPressed) {
+    PROFILE_BEGIN(PROF_DECODE);
+    handleDecoder();
+    PROFILE_END(PROF_DECODE);
+  }
+
+  if (manualKeyDown && !keyer.keyWasPressed && (!automaticKeys || !keyer.isKeying)) {
+    PROFILE_BEGIN(PROF_KEYER);
+    handleKeyPress();
+    PROFILE_END(PROF_KEYER);
+  }
+}
+
+// =========================================================================
+// INPUT DETECTION (MODE AUTO)
+// =========================================================================
+// With paddles and straight key both enabled, every contact is read in the
+// same port read and the first one used owns the keyer and its sidetone.
+// Ownership only changes at a character boundary (or to break in on host
+// text), so a stray touch on the other key cannot cut into a character.
+// A contact that is closed at power-on is taken as not being a key (e.g.
+// a mono straight-key plug in the paddle jack shorts the dash contact)
+// and ignored until it opens again. Only the power-on state counts, so a
+// key held down later, however long (tuning, a long dash by hand), is
+// never cut off; plug the keys in before switching on.
+
+uint8_t inputsPresent = KEY_DOT | KEY_DASH | KEY_STRAIGHT; // Contacts that behave like keys
+uint8_t inputsLast = 0;               // Contacts closed at the last change
+bool autoUsesPaddles = true;          // Current owner of the keyer
+
+/**
+ * @brief Takes the power-on contact state: closed contacts are not keys.
+ */
+void beginInputDetection() {
+  inputsLast = halReadKeys() & (KEY_PADDLES | KEY_STRAIGHT);
+  inputsPresent &= ~inputsLast;
+  autoUsesPaddles = (inputsPresent & KEY_PADDLES) != 0;
+}
+
+/**
+ * @brief Drops contacts that were closed at power-on until they open.
+ *        Costs one compare while the contacts are unchanged.
+ */
+uint8_t detectInputs(uint8_t keys) {
+  uint8_t squeeze = ((inputsPresent & KEY_PADDLES) == KEY_PADDLES) ? keys & KEY_SQUEEZE : 0;
+  keys &= KEY_PADDLES | KEY_STRAIGHT;
+  if (keys != inputsLast) {
+    inputsPresent |= inputsLast & ~keys; // A contact that opens again is a key
+    inputsLast = keys;
+  }
+  return (keys & inputsPresent) | squeeze;
+}
+
+/**
+ * @brief Reports which key owns the keyer after a change of hands.
+ */
+void reportInputOwner() {
+  if (telemetryEnabled || winkeyerActive()) return;
+  LineBuffer line;
+  line.length = 0;
+  lineAppend(line, autoUsesPaddles ? "\nInput: paddles\r\n" : "\nInput: straight key\r\n");
+  txStatus(line);
+}
+
+/**
+ * @brief Hands the keyer to the other key when it is used while the
+ *        owner is idle at a character boundary; returns the owner's keys.
+ */
+uint8_t arbitrateInputs(uint8_t keys) {
+  keys = detectInputs(keys);
+  uint8_t other = autoUsesPaddles ? KEY_STRAIGHT : KEY_PADDLES;
+  if ((keys & other) && !(keys & ~other & ~KEY_SQUEEZE)) {
+    if (sendQueueActive() || (!keyer.isKeying && !keyer.keyWasPressed && decoder.length == 0)) {
+      autoUsesPaddles = !autoUsesPaddles;
+      selectKeyerPass();
+      reportInputOwner();
+    }
+  }
+  return keys & (autoUsesPaddles ? KEY_PADDLES | KEY_SQUEEZE : KEY_STRAIGHT);
+}
+
+#if PADDLE_MODE == PADDLE_IAMBIC_A
+typedef IambicAPolicy BuildPaddlePolicy;
+#elif PADDLE_MODE == PADDLE_ULTIMATIC
+typedef UltimaticPolicy BuildPaddlePolicy;
+#elif PADDLE_MODE == PADDLE_SINGLE_LEVER
+typedef SingleLeverPolicy BuildPaddlePolicy;
+#elif PADDLE_MODE == PADDLE_BUG
+typedef BugPolicy BuildPaddlePolicy;
+#elif PADDLE_MODE == PADDLE_COOTIE
+typedef CootiePolicy BuildPaddlePolicy;
+#else
+typedef IambicBPolicy BuildPaddlePolicy;
+#endif
+
+#if KEYER_RUNTIME_MODES
+/**
+ * @brief Loads the current mode's style (the owner's, with MODE AUTO)
+ *        into ActiveStyle. Only called at a character boundary.
+ */
+void selectKeyerPass() {
+  typedef void (*StyleLoader)();
+  static const StyleLoader paddleStyles[PADDLE_MODE_COUNT] = {
+    loadStyle<IambicAPolicy>, loadStyle<IambicBPolicy>, loadStyle<UltimaticPolicy>, loadStyle<SingleLeverPolicy>,
+    loadStyle<BugPolicy>, loadStyle<CootiePolicy>
+  };
+  if (iambicModeActive && (!straightKeyModeActive || autoUsesPaddles)) {
+    paddleStyles[currentIambicMode]();
+  } else {
+    loadStyle<StraightKeyPolicy>();
+  }
+}
+
+inline void activeKeyerPass(uint8_t keys) {
+  if (iambicModeActive && straightKeyModeActive) keys = arbitrateInputs(keys); // May load the other style
+  keyerPass<ActiveStyle>(keys);
+}
+#else
+void selectKeyerPass() {}
+
+inline void buildKeyerPass(uint8_t keys) {
+#if IAMBIC_MODE == 1 && STRAIGHT_KEY_MODE == 1
+  keys = arbitrateInputs(keys);
+  if (autoUsesPaddles) {
+    keyerPass<BuildPaddlePolicy>(keys);
+  } else {
+    keyerPass<StraightKeyPolicy>(keys);
+  }
+#elif IAMBIC_MODE == 1
+  keyerPass<BuildPaddlePolicy>(keys);
+#else
+  keyerPass<StraightKeyPolicy>(keys);
+#endif
+}
+#endif
+
+// =========================================================================
+// IDLE BUDGET
+// =========================================================================
+// How long loop() may go uncalled without missing a deadline, assuming no
+// input changes meanwhile. The native simulator uses it to jump its virtual
+// clock over idle stretches instead of spinning through them.
+//
+// Nothing here repeats loop()'s decisions: every pass acts on whatever is
+// due at that moment, so all that is left afterwards is either work
+// already waiting in a buffer or flag (call again at once) or a deadline
+// the core has stored for later (the element end, the next element or
+// character, the decoder's character and word gaps, the memory button's
+// debounce, the beacon). The budget runs to the earliest stored deadline
+// that still lies ahead; one already reached was handled by the last pass
+// or no longer matters.
+
+const unsigned long IDLE_FOREVER = 0xFFFFFFFFUL;
+
+/**
+ * @brief Shortens budget so that loop() runs again at deadline, if it has
+ *        not been reached yet.
+ */
+void idleUntil(unsigned long* budget, unsigned long now, unsigned long deadline) {
+  if (timeReached(now, deadline)) return;
+  if (deadline - now < *budget) *budget = deadline - now;
+}
+
+/**
+ * @brief The same for a halMillis() deadline. halMillis() and halMicros()
+ *        tick apart, so loop() is called on every pass from the millisecond
+ *        before.
+ */
+void idleUntilMillis(unsigned long* budget, unsigned long millisNow, unsigned long deadline) {
+  if (timeReached(millisNow + 1, deadline)) {
+    *budget = 0;
+  } else if ((deadline - millisNow - 1) * 1000UL < *budget) {
+    *budget = (deadline - millisNow - 1) * 1000UL;
+  }
+}
+
+/**
+ * @brief Microseconds until the next pass of loop() has work to do
+ *        (0 = call again at once, IDLE_FOREVER = only after an input change).
+ */
+unsigned long idleBudget() {
+  // Work waiting for the next pass
+  if (rxHead != rxTail || statusLength != 0 || stampOut != stampIn) return 0;
+  if (baudState == BAUD_DRAINING) return 0;
+  if (pendingConfig.changes != 0 && !keyer.isKeying && !keyer.keyWasPressed && decoder.length == 0) return 0;
+  if (winkeyerActive() && winkeyerStatus() != winkeyerLastStatus) return 0;
+  if (jitterDumpLine <= JIT_KINDS) return 0;
+#if PROFILE_ENABLED
+  if (profileDumpLine < PROF_PHASES) return 0;
+#endif
+  if (memoryWriting()) return 0;
+
+  // Stored deadlines
+  unsigned long now = halMicros();
+  unsigned long millisNow = halMillis();
+  unsigned long budget = IDLE_FOREVER;
+  if (BEACON_MODE != 0) {
+    idleUntilMillis(&budget, millisNow, beaconDeadline);
+    return budget;
+  }
+  if (baudState == BAUD_CONFIRMING) idleUntilMillis(&budget, millisNow, baudDeadline);
+  if (memoryButtonRaw != memoryButtonDown) {
+    idleUntilMillis(&budget, millisNow, memoryButtonChangedTime + MEMORY_BUTTON_DEBOUNCE_MS);
+  } else if (memoryButtonPresses != 0 && !memoryButtonDown) {
+    idleUntilMillis(&budget, millisNow, memoryButtonChangedTime + MEMORY_BUTTON_SELECT_MS);
+  }
+  if (keyer.isKeying) idleUntil(&budget, now, keyer.elementStopTime);
+  idleUntil(&budget, now, keyer.nextElementTime);
+  unsigned long decodeTime;
+  if (decoder.nextDeadline(WORD_GAP, &decodeTime)) idleUntil(&budget, now, decodeTime);
+  return budget;
+}
+
+// =========================================================================
+// CORE RESET
+// =========================================================================
+// Puts every variable of the core back to its power-on value, for a host
+// program that boots the core more than once in one process:
+// halNativeReset() calls it and setup() follows, as after a real power-on.
+// The board never needs it. A variable added to the core gets a line here.
+
+void coreReset() {
+  // Keyer configuration and timing
+  currentIambicMode = (KeyerMode)PADDLE_MODE;
+  iambicModeActive = IAMBIC_MODE == 1;
+  straightKeyModeActive = STRAIGHT_KEY_MODE == 1;
+  currentWPM = 15;
+  toneFrequency = TONE_FREQ;
+  speedFromCommand = false;
+  farnsworthWPM = 0;
+  winkeyerMode = WINKEYER_DEFAULT;
+  DOT_DURATION = 1200000UL / currentWPM;
+  DASH_DURATION = 3 * DOT_DURATION;
+  ELEMENT_GAP = DOT_DURATION;
+  CHARACTER_GAP = 3 * DOT_DURATION;
+  WORD_GAP = 7 * DOT_DURATION;
+  lastPotReading = -POT_HYSTERESIS - 1;
+  memset(&keyer, 0, sizeof(keyer));
+  memset(&decoder, 0, sizeof(decoder));
+
+  // Serial rings, timestamps and diagnostics
+  memset(txRing, 0, sizeof(txRing));
+  txHead = 0;
+  txTail = 0;
+  memset(statusLine, 0, sizeof(statusLine));
+  statusLength = 0;
+  memset((void*)stamps, 0, sizeof(stamps));
+  stampIn = 0;
+  stampQueued = 0;
+  stampSent = 0;
+  stampOut = 0;
+  memset(rxRing, 0, sizeof(rxRing));
+  rxHead = 0;
+  rxTail = 0;
+  rxFramingErrors = 0;
+  currentBaud = SAFE_BAUD;
+  stampMode = false;
+  resetLatency();
+  resetJitter();
+  jitterDumpLine = JIT_KINDS + 1;
+#if PROFILE_ENABLED
+  resetProfile();
+  profileOverhead = 0;
+  profileDumpLine = PROF_PHASES;
+#endif
+  telemetryEnabled = TELEMETRY_DEFAULT;
+  lastTelemetryTime = 0;
+
+  // Beacon, send queue and message memories
+  beaconCharIndex = 0;
+  beaconCode = MORSE_CODE_WORD_SPACE;
+  beaconToneOn = false;
+  beaconDeadline = 0;
+  memset(sendQueue, 0, sizeof(sendQueue));
+  sendHead = 0;
+  sendTail = 0;
+  sendCode = MORSE_CODE_WORD_SPACE;
+  sendActive = false;
+  breakinActive = false;
+  memoryPlaying = false;
+  memset(memoryWriteBuffer, 0, sizeof(memoryWriteBuffer));
+  memoryWriteAddress = 0;
+  memoryWriteLength = 0;
+  memoryWriteIndex = 0;
+  memoryPlayAddress = 0;
+  memoryPlayEnd = 0;
+  memoryPlayBits = 0;
+  memoryPlayCount = 0;
+  memoryButtonRaw = false;
+  memoryButtonDown = false;
+  memoryButtonChangedTime = 0;
+  memoryButtonPresses = 0;
+
+  // Host commands and the WinKeyer protocol
+  memset(commandLine, 0, sizeof(commandLine));
+  commandLength = 0;
+  commandOverflow = false;
+  baudState = BAUD_STABLE;
+  pendingBaud = 0;
+  confirmedBaud = SAFE_BAUD;
+  baudDeadline = 0;
+  memset(&pendingConfig, 0, sizeof(pendingConfig));
+  winkeyerHostOpen = false;
+  winkeyerCommand = 0;
+  winkeyerArgumentsNeeded = 0;
+  memset(winkeyerArguments, 0, sizeof(winkeyerArguments));
+  winkeyerArgumentCount = 0;
+  winkeyerLastStatus = WK_STATUS;
+
+  // Input detection
+  inputsPresent = KEY_DOT | KEY_DASH | KEY_STRAIGHT;
+  inputsLast = 0;
+  autoUsesPaddles = true;
+}
+
+// =========================================================================
+// SETUP FUNCTION
+// =========================================================================
+void setup() {
+  // Pins (all inputs get their pull-ups so "MODE ..." can switch at
+  // runtime), sidetone timer and ADC
+  halBegin();
+  keyer.memoryEnabled = (DOT_MEMORY ? MEMORY_DOT : 0) | (DASH_MEMORY ? MEMORY_DASH : 0);
+  keyer.autospace = AUTOSPACE == 1;
+  keyer.reset(halMicros());
+  decoder.reset();
+  beginInputDetection();
+  selectKeyerPass();
+  serialBegin(winkeyerMode ? WINKEYER_BAUD : SAFE_BAUD);
+  halSidetoneFrequency(toneFrequency);
+
+  // Initial blocking read to set the default WPM and print the speed,
+  // then keep a conversion running for updateWPM() to harvest. The beacon
+  // keys at QRSS_DOT_MS and never reads the pot.
+  if (BEACON_MODE == 0) applyPotReading(halPotReadBlocking());
+
+#if PROFILE_ENABLED
+  profileBegin();
+#endif
+
+  if (BEACON_MODE != 0) {
+    beaconDeadline = halMillis();
+    txPrint((BEACON_MODE == BEACON_DFCW) ? "DFCW" : "QRSS");
+    txPrint(" Beacon Ready! Dot: ");
+    txPrint(QRSS_DOT_MS / 1000);
+    txPrintln("s");
+    return;
+  }
+
+  if (winkeyerMode) return; // No banner: the host expects protocol bytes only
+
+  // --- Runtime Configuration Check and Setup ---
+  if (iambicModeActive && straightKeyModeActive) {
+    txPrintln("Arduino Keyer Trainer Ready! Paddles or straight key");
+    txPrint("Paddles: ");
+    txPrintln(PADDLE_MODE_TITLES[currentIambicMode]);
+  } else if (iambicModeActive) {
+    const char* modeName = PADDLE_MODE_TITLES[currentIambicMode];
+    txPrintln("Arduino Iambic Keyer Trainer Ready!");
+    txPrint("Current Mode: ");
+    txPrintln(modeName);
+  } else if (straightKeyModeActive) {
+    txPrintln("Arduino Straight Key Decoder Ready!");
+  }
+
+  // Final check for configuration error
+  if (!iambicModeActive && !straightKeyModeActive) {
+    txPrintln("ERROR: No Keyer Mode is Active. Set IAMBIC_MODE or STRAIGHT_KEY_MODE to 1.");
+  }
+  
+  txPrintln("Start keying!");
+}
+
+// =========================================================================
+// MAIN LOOP
+// =========================================================================
+// Every pass is bounded: the pot is read without waiting for the ADC, the
+// inputs are single port reads, serial output only queues bytes and no heap
+// allocation happens, so the paddles are sampled every few tens of
+// microseconds even at 80 WPM.
+void loop() {
+  PROFILE_SCOPE(PROF_LOOP);
+
+  PROFILE_BEGIN(PROF_SERIAL_OUT);
+  txService();
+  handleStamps();
+  handleJitterDump();
+#if PROFILE_ENABLED
+  handleProfileDump();
+#endif
+  PROFILE_END(PROF_SERIAL_OUT);
+
+  PROFILE_BEGIN(PROF_COMMANDS);
+  handleSerialInput();
+  handleBaudChange();
+  applyPendingConfig();
+  handleMemoryWriter();
+  PROFILE_END(PROF_COMMANDS);
+
+  // Beacon mode runs unattended and owns the sidetone/LED
+  if (BEACON_MODE != 0) {
+    handleBeacon();
+    return;
+  }
+  
+  // 1. ALWAYS UPDATE SPEED FIRST
+  PROFILE_BEGIN(PROF_UPDATE_WPM);
+  updateWPM(); 
+  PROFILE_END(PROF_UPDATE_WPM);
+
+  // 2. TONE MANAGEMENT: Must handle tone output first to maintain non-blocking timing.
+  PROFILE_BEGIN(PROF_KEYER_OUTPUT);
+  handleKeyerOutput();
+  PROFILE_END(PROF_KEYER_OUTPUT);
+
+  // 3. INPUT: Read the current paddle/key states (LOW means pressed, due to PULLUP)
+  //    plus paddle presses latched by the edge interrupts since the last pass
+  PROFILE_BEGIN(PROF_READ_KEYS);
+  uint8_t keys = halReadKeys() | halTakeKeyPresses();
+  handleMemoryButton(keys);
+  PROFILE_END(PROF_READ_KEYS);
+
+  // 4./5. DECODE and KEYER LOGIC for the selected keying style
+#if KEYER_RUNTIME_MODES
+  activeKeyerPass(keys);
+#else
+  buildKeyerPass(keys);
+#endif
 }
\ No newline at end of file
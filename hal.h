@@ -0,0 +1,120 @@
+// Hardware abstraction layer for the code practice device.
+// The keyer, decoder and timing logic in "cw practice.cpp" only reach the
+// hardware through the functions below:
+//   hal_avr.cpp    - ATmega328P (Arduino Uno) registers and interrupts
+//   hal_native.cpp - Linux host with a virtual clock and scripted pin states
+// Exactly one of them is compiled, selected by the ARDUINO macro.
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =========================================================================
+// PIN DEFINITIONS (Arduino Uno numbering)
+// =========================================================================
+const int POT_PIN = 14;          // A0: analog pin for the WPM potentiometer
+const int LED_PIN = 13;          // Digital pin for the LED.
+const int BUZZER_PIN = 8;        // Digital pin for the buzzer/speaker.
+const int DOT_PIN = 2;           // Digital pin for the DOT paddle (connect to GND)
+const int DASH_PIN = 3;          // Digital pin for the DASH paddle (connect to GND)
+const int STRAIGHT_KEY_PIN = 4;  // Digital pin connected to the straight key (connect to GND)
+const int MEMORY_BUTTON_PIN = 5; // Push button that plays a message memory (connect to GND)
+
+// --- Pressed contacts, as returned by halReadKeys() ---
+const uint8_t KEY_DOT = 0x01;
+const uint8_t KEY_DASH = 0x02;
+const uint8_t KEY_STRAIGHT = 0x04;
+const uint8_t KEY_MEMORY = 0x08;  // Memory button
+const uint8_t KEY_PADDLES = KEY_DOT | KEY_DASH;
+const uint8_t KEY_SQUEEZE = 0x10; // halTakeKeyPresses(): both paddles were closed together
+
+const uint16_t EEPROM_BYTES = 1024; // ATmega328P EEPROM
+
+// =========================================================================
+// HAL INTERFACE
+// =========================================================================
+
+// Configures pins, the sidetone generator and the ADC.
+void halBegin();
+
+// Free-running clocks; both wrap (micros every ~71 minutes, millis every
+// ~49 days), so compare them with timeReached().
+unsigned long halMicros();
+unsigned long halMillis();
+
+// Returns the KEY_* bits of all contacts currently closed.
+uint8_t halReadKeys();
+
+// Paddle contacts seen closed at any edge since the last call, plus
+// KEY_SQUEEZE if both were closed at once, so presses shorter than a
+// loop() pass still reach the keyer. Clears the latch.
+uint8_t halTakeKeyPresses();
+
+// Turns the LED and sidetone on or off. Must be cheap: called on every edge.
+void halKeyOutput(bool on);
+
+// Retunes the sidetone; safe while the tone is on (DFCW shift).
+void halSidetoneFrequency(unsigned int frequency);
+
+// Non-blocking potentiometer read: returns true and a 0..1023 value when a
+// new conversion has finished, and starts the next one.
+bool halPotRead(int* value);
+int halPotReadBlocking();
+
+// Free-running CPU cycle counter for the loop profiler (Timer1 at F_CPU
+// on the AVR, so differences wrap after 65536 cycles / 4.096 ms).
+void halCycleCounterBegin();
+uint16_t halCycles();
+
+// Sleeps until the next interrupt (at most ~1 ms).
+void halSleep();
+
+// EEPROM. A write takes ~3.4 ms and runs in the background:
+// halEepromWrite() starts it and returns at once, and must only be called
+// once halEepromReady(). halEepromRead() waits for a write in progress.
+uint8_t halEepromRead(uint16_t address);
+bool halEepromReady();
+void halEepromWrite(uint16_t address, uint8_t value);
+
+// Critical sections around data shared with the serial interrupts.
+uint8_t halInterruptsOff();
+void halInterruptsRestore(uint8_t state);
+
+// UART: 8N1 at the given rate. halSerialKick() starts draining bytes
+// through serialTxNext(); halSerialIdle() is true once the last byte has
+// left the shift register.
+void halSerialBegin(unsigned long baud);
+void halSerialKick();
+bool halSerialIdle();
+
+// --- Implemented by the core, called from the serial interrupts ---
+bool serialTxNext(uint8_t* data);
+void serialRxByte(uint8_t data, bool framingError);
+
+#if !defined(ARDUINO)
+// =========================================================================
+// NATIVE (HOST) CONTROL, see hal_native.cpp
+// =========================================================================
+void setup();
+void loop();
+unsigned long idleBudget(); // Microseconds loop() can skip; see "cw practice.cpp"
+void coreReset();           // Power-on state of the core's variables; halNativeReset() calls it
+
+void halNativeReset();
+void halNativeAdvance(unsigned long microseconds);
+void halNativeSerialRate(unsigned long baud); // 0 (the default) drains the UART instantly
+uint64_t halNativeTime();
+uint64_t halNativeCycles(); // Modelled AVR cycles spent in HAL calls so far
+void halNativeSetKeys(uint8_t keys);
+void halNativeSetPot(int value);
+void halNativeReceive(const char* text);
+bool halNativeKeyOutput();
+unsigned int halNativeSidetoneFrequency();
+size_t halNativeTakeOutput(char* buffer, size_t size);
+#endif
+
+#endif // HAL_H
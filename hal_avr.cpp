@@ -0,0 +1,299 @@
+// ATmega328P (Arduino Uno) implementation of hal.h.
+
+#if defined(ARDUINO)
+
+#include <Arduino.h>       // Includes core Arduino definitions (pinMode, millis, etc.)
+#include <avr/interrupt.h> // ISR() for the sidetone, paddle and serial interrupts
+#include <avr/sleep.h>     // Idle sleep
+#include <avr/eeprom.h>    // Message memories
+#include "hal.h"
+
+// --- Fast I/O Registers (resolved once in halBegin()) ---
+// digitalWrite()/digitalRead() cost several microseconds each; the keyer
+// paths below use cached port registers instead.
+volatile uint8_t* ledPort;
+uint8_t ledMask;
+volatile uint8_t* buzzerPin;         // PINx register: writing a 1 toggles the pin
+volatile uint8_t* buzzerPort;
+uint8_t buzzerMask;
+bool sidetoneGate = false;           // Sidetone on: Timer2's compare interrupt is unmasked
+volatile uint8_t* dotPinReg;
+uint8_t dotPinMask;
+volatile uint8_t* dashPinReg;
+uint8_t dashPinMask;
+volatile uint8_t* straightKeyPinReg;
+uint8_t straightKeyPinMask;
+volatile uint8_t* memoryButtonPinReg;
+uint8_t memoryButtonPinMask;
+volatile uint8_t keyPresses = 0;     // Paddle latch, set by INT0/INT1
+
+/**
+ * @brief Starts an ADC conversion on the potentiometer channel.
+ *        analogRead() would block the loop for ~110 us on every pass.
+ */
+void potStartConversion() {
+  ADMUX = _BV(REFS0) | ((POT_PIN - A0) & 0x07); // AVcc reference
+  ADCSRA |= _BV(ADSC);
+}
+
+void halBegin() {
+  pinMode(LED_PIN, OUTPUT);
+  pinMode(BUZZER_PIN, OUTPUT);
+  pinMode(DOT_PIN, INPUT_PULLUP);
+  pinMode(DASH_PIN, INPUT_PULLUP);
+  pinMode(STRAIGHT_KEY_PIN, INPUT_PULLUP);
+  pinMode(MEMORY_BUTTON_PIN, INPUT_PULLUP);
+
+  ledPort = portOutputRegister(digitalPinToPort(LED_PIN));
+  ledMask = digitalPinToBitMask(LED_PIN);
+  buzzerPin = portInputRegister(digitalPinToPort(BUZZER_PIN));
+  buzzerPort = portOutputRegister(digitalPinToPort(BUZZER_PIN));
+  buzzerMask = digitalPinToBitMask(BUZZER_PIN);
+  dotPinReg = portInputRegister(digitalPinToPort(DOT_PIN));
+  dotPinMask = digitalPinToBitMask(DOT_PIN);
+  dashPinReg = portInputRegister(digitalPinToPort(DASH_PIN));
+  dashPinMask = digitalPinToBitMask(DASH_PIN);
+  straightKeyPinReg = portInputRegister(digitalPinToPort(STRAIGHT_KEY_PIN));
+  straightKeyPinMask = digitalPinToBitMask(STRAIGHT_KEY_PIN);
+  memoryButtonPinReg = portInputRegister(digitalPinToPort(MEMORY_BUTTON_PIN));
+  memoryButtonPinMask = digitalPinToBitMask(MEMORY_BUTTON_PIN);
+
+  // Paddle latches: D2/D3 are INT0/INT1, interrupting on either edge
+  if (DOT_PIN == 2 && DASH_PIN == 3) {
+    EICRA = _BV(ISC00) | _BV(ISC10);
+    EIFR = _BV(INTF0) | _BV(INTF1);
+    EIMSK = _BV(INT0) | _BV(INT1);
+  }
+
+  set_sleep_mode(SLEEP_MODE_IDLE); // Keeps Timer0, Timer2 and the USART running
+}
+
+unsigned long halMicros() {
+  return micros();
+}
+
+unsigned long halMillis() {
+  return millis();
+}
+
+/**
+ * @brief With the keys and the memory button on D2..D5 (PORTD bits 2..5,
+ *        in KEY_* order) all contacts come from one PIND read; other pin
+ *        choices fall back to the cached per-pin registers. The test folds
+ *        away at compile time.
+ */
+uint8_t halReadKeys() {
+  if (DOT_PIN == 2 && DASH_PIN == 3 && STRAIGHT_KEY_PIN == 4 && MEMORY_BUTTON_PIN == 5) {
+    return (uint8_t)(~PIND >> 2) & (KEY_DOT | KEY_DASH | KEY_STRAIGHT | KEY_MEMORY);
+  }
+  uint8_t keys = 0;
+  if (!(*dotPinReg & dotPinMask)) keys |= KEY_DOT;
+  if (!(*dashPinReg & dashPinMask)) keys |= KEY_DASH;
+  if (!(*straightKeyPinReg & straightKeyPinMask)) keys |= KEY_STRAIGHT;
+  if (!(*memoryButtonPinReg & memoryButtonPinMask)) keys |= KEY_MEMORY;
+  return keys;
+}
+
+/**
+ * @brief Latches the paddle state at every paddle edge.
+ */
+inline void paddleEdge() {
+  uint8_t paddles = (uint8_t)(~PIND >> 2) & KEY_PADDLES;
+  keyPresses |= paddles;
+  if (paddles == KEY_PADDLES) keyPresses |= KEY_SQUEEZE;
+}
+
+ISR(INT0_vect) {
+  paddleEdge();
+}
+
+ISR(INT1_vect) {
+  paddleEdge();
+}
+
+uint8_t halTakeKeyPresses() {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  uint8_t presses = keyPresses;
+  keyPresses = 0;
+  SREG = oldSREG;
+  return presses;
+}
+
+// =========================================================================
+// SIDETONE (Timer2)
+// =========================================================================
+// tone()/noTone() reprogram Timer2 on every element, which takes tens of
+// microseconds. Instead Timer2 stays programmed for the sidetone frequency
+// and keying only unmasks its compare interrupt (restarting the count, so
+// every element starts on a full half period) and masks it again. With
+// the key up Timer2 raises no interrupts, so idle sleep is not woken at
+// twice the tone frequency.
+
+/**
+ * @brief Programs Timer2 in CTC mode to interrupt at twice the tone frequency.
+ */
+void halSidetoneFrequency(unsigned int frequency) {
+  static const uint16_t prescalers[] = { 1, 8, 32, 64, 128, 256, 1024 };
+  uint8_t clockSelect = 1;
+  unsigned long compare = 0;
+
+  // Use the smallest prescaler that fits the compare value into 8 bits
+  for (uint8_t i = 0; i < 7; i++) {
+    compare = F_CPU / (2UL * frequency * prescalers[i]) - 1;
+    clockSelect = i + 1;
+    if (compare <= 255) break;
+  }
+  if (compare > 255) compare = 255;
+
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  TCCR2A = _BV(WGM21);  // CTC, TOP = OCR2A
+  TCCR2B = clockSelect; // CS22:0
+  OCR2A = (uint8_t)compare;
+  TCNT2 = 0;
+  TIMSK2 = sidetoneGate ? _BV(OCIE2A) : 0;
+  SREG = oldSREG;
+}
+
+ISR(TIMER2_COMPA_vect) {
+  *buzzerPin = buzzerMask;
+}
+
+/**
+ * @brief Gates the LED and sidetone; off leaves the buzzer pin LOW.
+ */
+void halKeyOutput(bool on) {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  if (on) {
+    *ledPort |= ledMask;
+    if (!sidetoneGate) {
+      TCNT2 = 0;
+      TIFR2 = _BV(OCF2A); // Drop a compare match from while the gate was closed
+      TIMSK2 = _BV(OCIE2A);
+    }
+    sidetoneGate = true;
+  } else {
+    sidetoneGate = false;
+    TIMSK2 = 0;
+    *ledPort &= ~ledMask;
+    *buzzerPort &= ~buzzerMask;
+  }
+  SREG = oldSREG;
+}
+
+// =========================================================================
+// POTENTIOMETER (ADC)
+// =========================================================================
+
+bool halPotRead(int* value) {
+  if (ADCSRA & _BV(ADSC)) return false; // Conversion still in progress
+  *value = ADC;
+  potStartConversion();
+  return true;
+}
+
+/**
+ * @brief Blocking read for setup(); leaves a conversion running for halPotRead().
+ */
+int halPotReadBlocking() {
+  int value = analogRead(POT_PIN);
+  potStartConversion();
+  return value;
+}
+
+// =========================================================================
+// EEPROM
+// =========================================================================
+
+uint8_t halEepromRead(uint16_t address) {
+  return eeprom_read_byte((const uint8_t*)(size_t)address);
+}
+
+bool halEepromReady() {
+  return eeprom_is_ready();
+}
+
+/**
+ * @brief eeprom_write_byte() only waits for a previous write, which the
+ *        caller has ruled out, and returns once this one has started.
+ */
+void halEepromWrite(uint16_t address, uint8_t value) {
+  eeprom_write_byte((uint8_t*)(size_t)address, value);
+}
+
+// =========================================================================
+// CYCLE COUNTER (Timer1)
+// =========================================================================
+
+void halCycleCounterBegin() {
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10); // Normal mode, no prescaler
+  TIMSK1 = 0;
+  TCNT1 = 0;
+}
+
+uint16_t halCycles() {
+  return TCNT1;
+}
+
+// =========================================================================
+// SLEEP AND CRITICAL SECTIONS
+// =========================================================================
+
+void halSleep() {
+  sleep_mode(); // Idle sleep; Timer0 wakes us within ~1 ms, Timer2 only while the key is down
+}
+
+uint8_t halInterruptsOff() {
+  uint8_t oldSREG = SREG;
+  noInterrupts();
+  return oldSREG;
+}
+
+void halInterruptsRestore(uint8_t state) {
+  SREG = state;
+}
+
+// =========================================================================
+// SERIAL (USART0)
+// =========================================================================
+
+/**
+ * @brief Initialises USART0 for 8N1 at the given baud rate (double speed mode).
+ *        At 16 MHz this gives exact 500000 and 1000000 baud and 115200 at +2.1%.
+ */
+void halSerialBegin(unsigned long baud) {
+  UCSR0B = 0;
+  UCSR0A = _BV(U2X0);
+  UBRR0 = (F_CPU / 4 / baud - 1) / 2;
+  UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+  UCSR0B = _BV(TXEN0) | _BV(RXEN0) | _BV(RXCIE0) | _BV(UDRIE0);
+}
+
+void halSerialKick() {
+  UCSR0B |= _BV(UDRIE0);
+}
+
+bool halSerialIdle() {
+  return !(UCSR0B & _BV(UDRIE0)) && (UCSR0A & _BV(TXC0));
+}
+
+ISR(USART_RX_vect) {
+  bool framingError = UCSR0A & _BV(FE0);
+  uint8_t data = UDR0;
+  serialRxByte(data, framingError);
+}
+
+ISR(USART_UDRE_vect) {
+  uint8_t data;
+  if (serialTxNext(&data)) {
+    UDR0 = data;
+    UCSR0A = _BV(U2X0) | _BV(TXC0); // Clear TXC0 so halSerialIdle() sees this byte
+  } else {
+    UCSR0B &= ~_BV(UDRIE0); // Ring empty: stop interrupting
+  }
+}
+
+#endif // ARDUINO
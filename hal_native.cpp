@@ -0,0 +1,289 @@
+// Native (Linux host) implementation of hal.h.
+// Time is a virtual clock that only moves when the host program calls
+// halNativeAdvance(), and key contacts and the pot are whatever the host
+// last set, so the keyer core runs deterministically off the board.
+// The UART drains instantly unless halNativeSerialRate() sets a baud rate,
+// in which case bytes leave one per 10 bit times as the clock advances.
+// CMakeLists.txt builds it with the sketch into the cwcore library; a
+// host program links against it, calls setup() once and loop() repeatedly.
+
+#if !defined(ARDUINO)
+
+#include <string>
+#include <vector>
+#include "hal.h"
+
+// --- Virtual Hardware State ---
+uint64_t nativeMicros = 0;            // Virtual time; 64 bits so the HAL clocks wrap like the AVR's
+uint8_t nativeKeys = 0;               // KEY_* bits currently closed
+uint8_t nativeKeyPresses = 0;         // Paddle latch, as INT0/INT1 would set it
+int nativePot = 0;                    // 0..1023
+uint64_t nativePotReadyAt = 0;        // Models the ~104 us ADC conversion
+bool nativeKeyOutput = false;
+unsigned int nativeSidetone = 0;
+bool nativeSerialInterrupts = true;   // Mirrors the AVR global interrupt flag
+std::string nativeOutput;             // Bytes written to the "UART"
+unsigned long nativeSerialRate = 0;   // Drain rate in baud, 0 = instant; kept across halNativeReset()
+uint64_t nativeTxReadyAt = 0;         // When the UART can take the next byte
+std::vector<uint8_t> nativeEeprom(EEPROM_BYTES, 0xFF); // Erased; kept across halNativeReset()
+uint64_t nativeEepromReadyAt = 0;     // End of the write in progress
+
+const unsigned long NATIVE_ADC_MICROS = 104;
+const unsigned long NATIVE_EEPROM_WRITE_MICROS = 3400;
+
+// --- AVR Cost Model ---
+// Estimated ATmega328P cycles (16 MHz, call overhead included) for each
+// HAL operation, accumulated in nativeCycles so host benchmarks can report
+// what the same calls would cost on the board. The core's own arithmetic
+// is not modelled.
+const unsigned int CYCLES_MICROS = 70;       // Arduino micros(): cli, 32-bit reads, shifts
+const unsigned int CYCLES_MILLIS = 30;
+const unsigned int CYCLES_READ_KEYS = 6;     // One PIND read, complement, shift, mask
+const unsigned int CYCLES_KEY_PRESSES = 8;   // SREG save, read and clear the latch
+const unsigned int CYCLES_KEY_OUTPUT = 40;   // SREG save, two port read-modify-writes, Timer2 mask
+const unsigned int CYCLES_SIDETONE = 2000;   // 32-bit divisions in the prescaler search
+const unsigned int CYCLES_POT_BUSY = 8;      // ADSC still set
+const unsigned int CYCLES_POT_READ = 25;     // Read ADC and restart the conversion
+const unsigned int CYCLES_INTERRUPTS = 4;
+const unsigned int CYCLES_SERIAL_KICK = 8;
+const unsigned int CYCLES_SERIAL_BYTE = 60;  // One UDRE interrupt including prologue
+const unsigned int CYCLES_EEPROM_READ = 12;
+const unsigned int CYCLES_EEPROM_WRITE = 20;
+uint64_t nativeCycles = 0;
+
+/**
+ * @brief Returns every simulated peripheral, and the core's variables
+ *        (coreReset()), to their power-on state. EEPROM is kept.
+ */
+void halNativeReset() {
+  nativeMicros = 0;
+  nativeKeys = 0;
+  nativeKeyPresses = 0;
+  nativePot = 0;
+  nativePotReadyAt = 0;
+  nativeKeyOutput = false;
+  nativeSidetone = 0;
+  nativeSerialInterrupts = true;
+  nativeOutput.clear();
+  nativeTxReadyAt = 0;
+  nativeEepromReadyAt = 0;
+  nativeCycles = 0;
+  coreReset();
+}
+
+/**
+ * @brief Hands one byte from the core to the UART, as the UDRE interrupt
+ *        would. Returns false once the ring is empty.
+ */
+bool nativeSerialSend() {
+  uint8_t data;
+  if (!serialTxNext(&data)) return false;
+  nativeCycles += CYCLES_SERIAL_BYTE;
+  nativeOutput += (char)data;
+  if (nativeSerialRate) nativeTxReadyAt = nativeMicros + 10000000ULL / nativeSerialRate;
+  return true;
+}
+
+/**
+ * @brief Limits the UART to baud (8N1, 10 bits a byte) so the TX ring can
+ *        fill and its overflow policy is exercised; 0 drains instantly.
+ */
+void halNativeSerialRate(unsigned long baud) {
+  nativeSerialRate = baud;
+  nativeTxReadyAt = 0;
+}
+
+/**
+ * @brief Moves the virtual clock on. With a limited serial rate every byte
+ *        due in the interval leaves at its own time, so the core's latency
+ *        stamps see when it was sent.
+ */
+void halNativeAdvance(unsigned long microseconds) {
+  uint64_t end = nativeMicros + microseconds;
+  while (nativeSerialRate && nativeSerialInterrupts && nativeTxReadyAt <= end) {
+    if (nativeTxReadyAt > nativeMicros) nativeMicros = nativeTxReadyAt;
+    if (!nativeSerialSend()) break;
+  }
+  nativeMicros = end;
+}
+
+uint64_t halNativeTime() {
+  return nativeMicros;
+}
+
+uint64_t halNativeCycles() {
+  return nativeCycles;
+}
+
+void halNativeSetKeys(uint8_t keys) {
+  nativeKeys = keys;
+  // What the INT0/INT1 handler latches on a paddle edge
+  uint8_t paddles = keys & KEY_PADDLES;
+  nativeKeyPresses |= paddles;
+  if (paddles == KEY_PADDLES) nativeKeyPresses |= KEY_SQUEEZE;
+}
+
+void halNativeSetPot(int value) {
+  nativePot = value;
+}
+
+/**
+ * @brief Delivers text to the core as if it had arrived on the UART.
+ */
+void halNativeReceive(const char* text) {
+  while (*text) serialRxByte((uint8_t)*text++, false);
+}
+
+bool halNativeKeyOutput() {
+  return nativeKeyOutput;
+}
+
+unsigned int halNativeSidetoneFrequency() {
+  return nativeSidetone;
+}
+
+/**
+ * @brief Moves captured serial output into buffer (NUL terminated) and
+ *        returns the number of bytes copied.
+ */
+size_t halNativeTakeOutput(char* buffer, size_t size) {
+  if (size == 0) return 0;
+  size_t length = nativeOutput.size() < size - 1 ? nativeOutput.size() : size - 1;
+  memcpy(buffer, nativeOutput.data(), length);
+  buffer[length] = '\0';
+  nativeOutput.erase(0, length);
+  return length;
+}
+
+// =========================================================================
+// HAL INTERFACE
+// =========================================================================
+
+void halBegin() {
+  nativeKeyOutput = false;
+}
+
+unsigned long halMicros() {
+  nativeCycles += CYCLES_MICROS;
+  return (unsigned long)(uint32_t)nativeMicros;
+}
+
+unsigned long halMillis() {
+  nativeCycles += CYCLES_MILLIS;
+  return (unsigned long)(uint32_t)(nativeMicros / 1000);
+}
+
+uint8_t halReadKeys() {
+  nativeCycles += CYCLES_READ_KEYS;
+  return nativeKeys;
+}
+
+uint8_t halTakeKeyPresses() {
+  nativeCycles += CYCLES_KEY_PRESSES;
+  uint8_t presses = nativeKeyPresses;
+  nativeKeyPresses = 0;
+  return presses;
+}
+
+void halKeyOutput(bool on) {
+  nativeCycles += CYCLES_KEY_OUTPUT;
+  nativeKeyOutput = on;
+}
+
+void halSidetoneFrequency(unsigned int frequency) {
+  nativeCycles += CYCLES_SIDETONE;
+  nativeSidetone = frequency;
+}
+
+bool halPotRead(int* value) {
+  if (nativeMicros < nativePotReadyAt) {
+    nativeCycles += CYCLES_POT_BUSY;
+    return false;
+  }
+  nativeCycles += CYCLES_POT_READ;
+  *value = nativePot;
+  nativePotReadyAt = nativeMicros + NATIVE_ADC_MICROS;
+  return true;
+}
+
+int halPotReadBlocking() {
+  nativePotReadyAt = nativeMicros + NATIVE_ADC_MICROS;
+  return nativePot;
+}
+
+/**
+ * @brief Like the AVR, a read during a write stalls until the write is done.
+ */
+uint8_t halEepromRead(uint16_t address) {
+  nativeCycles += CYCLES_EEPROM_READ;
+  if (nativeMicros < nativeEepromReadyAt) nativeMicros = nativeEepromReadyAt;
+  return address < EEPROM_BYTES ? nativeEeprom[address] : 0xFF;
+}
+
+bool halEepromReady() {
+  return nativeMicros >= nativeEepromReadyAt;
+}
+
+void halEepromWrite(uint16_t address, uint8_t value) {
+  nativeCycles += CYCLES_EEPROM_WRITE;
+  if (nativeMicros < nativeEepromReadyAt) nativeMicros = nativeEepromReadyAt;
+  if (address < EEPROM_BYTES) nativeEeprom[address] = value;
+  nativeEepromReadyAt = nativeMicros + NATIVE_EEPROM_WRITE_MICROS;
+}
+
+void halCycleCounterBegin() {
+}
+
+/**
+ * @brief The modelled cycles; the measurement itself is not charged.
+ */
+uint16_t halCycles() {
+  return (uint16_t)nativeCycles;
+}
+
+/**
+ * @brief Idle sleep ends at the next Timer0 overflow on the AVR, so the
+ *        virtual clock moves on to the next 1024 us boundary.
+ */
+void halSleep() {
+  nativeMicros += 1024 - nativeMicros % 1024;
+}
+
+uint8_t halInterruptsOff() {
+  nativeCycles += CYCLES_INTERRUPTS;
+  uint8_t state = nativeSerialInterrupts;
+  nativeSerialInterrupts = false;
+  return state;
+}
+
+void halInterruptsRestore(uint8_t state) {
+  nativeCycles += CYCLES_INTERRUPTS;
+  nativeSerialInterrupts = state;
+  if (state) halSerialKick();
+}
+
+void halSerialBegin(unsigned long baud) {
+  (void)baud;
+}
+
+/**
+ * @brief With no rate set the host UART is infinitely fast and queued bytes
+ *        leave at once; otherwise one byte leaves if the UART is free and
+ *        halNativeAdvance() sends the rest. Nothing moves while the core is
+ *        inside a critical section.
+ */
+void halSerialKick() {
+  nativeCycles += CYCLES_SERIAL_KICK;
+  if (!nativeSerialInterrupts) return;
+  if (nativeSerialRate) {
+    if (nativeTxReadyAt <= nativeMicros) nativeSerialSend();
+    return;
+  }
+  while (nativeSerialSend()) {}
+}
+
+bool halSerialIdle() {
+  return nativeTxReadyAt <= nativeMicros;
+}
+
+#endif // !ARDUINO
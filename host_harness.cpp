@@ -0,0 +1,49 @@
+// Shared helpers for the host programs; see host_harness.h.
+
+#if !defined(ARDUINO)
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "hal.h"
+#include "host_harness.h"
+
+std::string drainOutput() {
+  std::string output;
+  char buffer[256];
+  size_t length;
+  while ((length = halNativeTakeOutput(buffer, sizeof(buffer))) > 0) output.append(buffer, length);
+  return output;
+}
+
+bool runIsolated(void (*run)(const void* arg, std::string* result), const void* arg, std::string* result) {
+  int fds[2];
+  if (pipe(fds) != 0) return false;
+  fflush(stdout);
+  pid_t child = fork();
+  if (child == 0) {
+    close(fds[0]);
+    std::string own;
+    run(arg, &own);
+    const char* bytes = own.data();
+    size_t left = own.size();
+    while (left > 0) {
+      ssize_t written = write(fds[1], bytes, left);
+      if (written <= 0) _exit(1);
+      bytes += written;
+      left -= written;
+    }
+    _exit(0);
+  }
+  close(fds[1]);
+  result->clear();
+  char buffer[4096];
+  ssize_t got;
+  while (child > 0 && (got = read(fds[0], buffer, sizeof(buffer))) > 0) result->append(buffer, got);
+  close(fds[0]);
+  int status = 0;
+  if (child > 0) waitpid(child, &status, 0);
+  return child > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+#endif // !ARDUINO
@@ -0,0 +1,24 @@
+// Shared helpers for the host programs that drive the keyer core on the
+// native HAL (cer.cpp, overflow.cpp, squeeze.cpp, wcet.cpp,
+// winkeyer.cpp).
+// halNativeReset() already returns the core to its power-on state, so runs
+// can follow each other in one process; runIsolated() is for the programs
+// that must survive a crash in the core and report it.
+
+#ifndef HOST_HARNESS_H
+#define HOST_HARNESS_H
+
+#if !defined(ARDUINO)
+
+#include <string>
+
+// Everything the core has sent since the last call.
+std::string drainOutput();
+
+// Runs run(arg, result) in a forked child and hands *result back through a
+// pipe. Returns false if the child crashed or its result did not arrive.
+bool runIsolated(void (*run)(const void* arg, std::string* result), const void* arg, std::string* result);
+
+#endif // !ARDUINO
+
+#endif // HOST_HARNESS_H
@@ -0,0 +1,288 @@
+// Keyer and decoder state for the code practice device.
+// Neither object touches the hardware or any global: every method takes
+// the current time (halMicros() on the device, virtual time on the host)
+// and the durations it needs, and tells the caller what to do. The sketch
+// drives one KeyerState and one DecoderState; its glue (sidetone, key
+// output, serial echo, telemetry) exists once, so the device keys and
+// decodes one key at a time. More instances only run side by side on the
+// host (the simulated students in benchmark.cpp). The methods are
+// implemented in "cw practice.cpp" (KEYER AND DECODER STATE).
+
+#ifndef KEYER_H
+#define KEYER_H
+
+#include <stdint.h>
+
+// --- Keyer Mode Configuration ---
+enum KeyerMode {
+  MODE_A,            // Iambic Mode A (No Squeeze Memory)
+  MODE_B,            // Iambic Mode B (Squeeze Memory)
+  MODE_ULTIMATIC,    // The paddle pressed last wins a squeeze
+  MODE_SINGLE_LEVER, // Squeezes ignored: the paddle pressed first keeps keying
+  MODE_BUG,          // Semi-automatic: automatic dots, dash contact keyed by hand
+  MODE_COOTIE        // Sideswiper: both contacts keyed by hand
+};
+
+// --- How a squeeze (both paddles closed) is resolved ---
+enum SqueezeRule {
+  SQUEEZE_ALTERNATE, // Iambic
+  SQUEEZE_LAST,      // Ultimatic
+  SQUEEZE_FIRST      // Single lever
+};
+
+// --- Paddle Memory (bits, switched independently) ---
+enum PaddleMemory {
+  MEMORY_OFF = 0,
+  MEMORY_DOT = 1,  // A dot tapped during a dash is sent next
+  MEMORY_DASH = 2, // A dash tapped during a dot is sent next
+  MEMORY_BOTH = 3
+};
+
+const int MAX_SEQUENCE_LENGTH = 7;   // Longest sequence kept; longer input decodes as '?'
+
+/**
+ * @brief Element timing of one keyer. Deadlines come first: they are
+ *        compared on every pass, the flags only on edges.
+ */
+struct KeyerState {
+  unsigned long elementStopTime;   // Deadline for the end of the tone
+  unsigned long nextElementTime;   // Deadline for the next element
+  unsigned long characterTime;     // Character boundary after the last element (autospace, decoder)
+  unsigned long keyReleaseTime;    // Last element end or straight-key release
+  unsigned long keyPressStartTime; // Straight key: time of key down
+  bool isKeying;                   // An element is sounding
+  bool keyWasPressed;              // Straight key is down
+  bool squeezeMemory;              // Both paddles were closed during this element (Mode B)
+  uint8_t memoryEnabled;           // PaddleMemory bits; set by the owner, kept by reset()
+  bool autospace;                  // Hold-off to a full character gap; set by the owner, kept by reset()
+  uint8_t memoryArmed;             // PaddleMemory bits of paddles seen open during this element
+  uint8_t paddleMemory;            // Opposite paddle tapped during this element
+  uint8_t paddlesClosed;           // PaddleMemory bits of paddles closed on the last pass
+  char lastPressed;                // Paddle closed most recently ('.' or '-')
+  bool gapScheduled;               // nextElementTime is a real deadline for the next start
+  char keyingElement;              // Element sounding, or the last one sent
+
+  void reset(unsigned long now);
+
+  // Starts a '.' or '-' of the given length and schedules the next element
+  // and the character boundary after it.
+  void startElement(unsigned long now, char element, unsigned long duration,
+                    unsigned long elementGap, unsigned long characterGap);
+
+  // True once the sounding element has reached elementStopTime.
+  bool elementDue(unsigned long now) const;
+  void stopElement(unsigned long now);
+
+  // Paddle logic, called on every pass with the paddles closed now or
+  // latched since the last pass. Until nextElementTime it only watches
+  // for a squeeze or a tap on the opposite paddle; then it returns the
+  // element to start ('.' or '-'), or '\0' when none is due. Policy is
+  // one of the paddle keying styles below.
+  template <class Policy>
+  char iambicNext(unsigned long now, bool dotPaddle, bool dashPaddle, bool squeezed);
+
+  // Hand-keyed edges (straight key, bug dashes, cootie); a press ends any
+  // scheduled gap, keyUp() returns how long the key was held.
+  void keyDown(unsigned long now);
+  unsigned long keyUp(unsigned long now);
+};
+
+// =========================================================================
+// KEYING STYLES
+// =========================================================================
+// Each style is a policy type for the templated keyer pass in the sketch
+// and for KeyerState::iambicNext(). PADDLES picks the paddle jack or the
+// straight key; MANUAL_DOT / MANUAL_DASH mark paddle contacts that are
+// keyed by hand like a straight key instead of running the element
+// scheduler. Everything is static, so each style compiles to its own
+// branch-free code.
+//
+// Iambic timing (Curtis): while both paddles are closed the keyer
+// alternates, starting with a dot from idle. The next element is chosen
+// once the current one and its gap are over:
+//   Mode A - from the paddles closed at that moment; releasing a squeeze
+//            stops the keyer after the element in progress.
+//   Mode B - as Mode A, but if both paddles were closed together at any
+//            time during the element or its gap, the opposite element
+//            follows even when the paddles have been released.
+//   Ultimatic - while both are closed the paddle pressed last repeats;
+//            releasing it hands back to the other one.
+//   Single lever - a squeeze is ignored: the paddle pressed first keeps
+//            repeating until it is released.
+// Ultimatic and single lever track press order on every pass; the
+// iambic styles compile without it.
+// Dot and dash memory (memoryEnabled, any paddle style): a press of the
+// opposite paddle that starts during the element or its gap is sent
+// next, even if the paddle opened again long before the deadline. A
+// paddle already held when the element was chosen is not a tap, so
+// releasing a squeeze in Mode A still stops the keyer.
+// Autospace (autospace, any paddle style): if no paddle is closed when an
+// element gap ends, the character is over and nextElementTime moves on to
+// characterTime, the full character gap. A press during that hold-off is
+// kept and sent at the boundary.
+//
+// Bug (semi-automatic): the dot contact runs the scheduler for dots only,
+// the dash contact is a straight key. Cootie (sideswiper): both contacts
+// are straight keys. Hand-keyed and automatic elements feed the same
+// decoder; an automatic dot waits while the hand key is down, and a hand
+// press waits for an automatic dot to end.
+
+struct StraightKeyPolicy {
+  static const bool PADDLES = false;
+  static const SqueezeRule SQUEEZE = SQUEEZE_ALTERNATE;
+  static const bool SQUEEZE_MEMORY = false;
+  static const bool MANUAL_DOT = false;
+  static const bool MANUAL_DASH = false;
+};
+
+struct IambicAPolicy {
+  static const bool PADDLES = true;
+  static const KeyerMode MODE = MODE_A;
+  static const SqueezeRule SQUEEZE = SQUEEZE_ALTERNATE;
+  static const bool SQUEEZE_MEMORY = false;
+  static const bool MANUAL_DOT = false;
+  static const bool MANUAL_DASH = false;
+};
+
+struct IambicBPolicy {
+  static const bool PADDLES = true;
+  static const KeyerMode MODE = MODE_B;
+  static const SqueezeRule SQUEEZE = SQUEEZE_ALTERNATE;
+  static const bool SQUEEZE_MEMORY = true;
+  static const bool MANUAL_DOT = false;
+  static const bool MANUAL_DASH = false;
+};
+
+struct UltimaticPolicy {
+  static const bool PADDLES = true;
+  static const KeyerMode MODE = MODE_ULTIMATIC;
+  static const SqueezeRule SQUEEZE = SQUEEZE_LAST;
+  static const bool SQUEEZE_MEMORY = false;
+  static const bool MANUAL_DOT = false;
+  static const bool MANUAL_DASH = false;
+};
+
+struct SingleLeverPolicy {
+  static const bool PADDLES = true;
+  static const KeyerMode MODE = MODE_SINGLE_LEVER;
+  static const SqueezeRule SQUEEZE = SQUEEZE_FIRST;
+  static const bool SQUEEZE_MEMORY = false;
+  static const bool MANUAL_DOT = false;
+  static const bool MANUAL_DASH = false;
+};
+
+struct BugPolicy {
+  static const bool PADDLES = true;
+  static const KeyerMode MODE = MODE_BUG;
+  static const SqueezeRule SQUEEZE = SQUEEZE_ALTERNATE;
+  static const bool SQUEEZE_MEMORY = false;
+  static const bool MANUAL_DOT = false;
+  static const bool MANUAL_DASH = true;
+};
+
+struct CootiePolicy {
+  static const bool PADDLES = true;
+  static const KeyerMode MODE = MODE_COOTIE;
+  static const SqueezeRule SQUEEZE = SQUEEZE_ALTERNATE;
+  static const bool SQUEEZE_MEMORY = false;
+  static const bool MANUAL_DOT = true;
+  static const bool MANUAL_DASH = true;
+};
+
+template <class Policy>
+char KeyerState::iambicNext(unsigned long now, bool dotPaddle, bool dashPaddle, bool squeezed) {
+  bool both = squeezed || (dotPaddle && dashPaddle);
+  uint8_t closed = (dotPaddle ? MEMORY_DOT : 0) | (dashPaddle ? MEMORY_DASH : 0);
+  if (Policy::SQUEEZE != SQUEEZE_ALTERNATE) {
+    // Press order; a simultaneous press counts the dash as the later one
+    uint8_t pressed = closed & ~paddlesClosed;
+    if (pressed & MEMORY_DOT) lastPressed = '.';
+    if (pressed & MEMORY_DASH) lastPressed = '-';
+    paddlesClosed = closed;
+  }
+  if ((long)(now - nextElementTime) < 0) {
+    // Element or gap in progress (wrap-safe compare): only latch a squeeze
+    // and taps on the opposite paddle, or any press during a hold-off
+    if (Policy::SQUEEZE_MEMORY && both) squeezeMemory = true;
+    if (!gapScheduled) {
+      paddleMemory |= closed;
+    } else if (memoryEnabled) {
+      uint8_t opposite = (keyingElement == '.') ? MEMORY_DASH : MEMORY_DOT;
+      paddleMemory |= closed & memoryArmed & opposite;
+      memoryArmed |= ~closed & memoryEnabled;
+    }
+    return '\0';
+  }
+
+  char opposite = (keyingElement == '.') ? '-' : '.';
+  char element;
+  if (dotPaddle && dashPaddle) {
+    if (Policy::SQUEEZE == SQUEEZE_LAST) {
+      element = lastPressed;
+    } else if (Policy::SQUEEZE == SQUEEZE_FIRST) {
+      element = (lastPressed == '.') ? '-' : '.';
+    } else {
+      element = gapScheduled ? opposite : '.';
+    }
+  } else if (Policy::SQUEEZE_MEMORY && squeezeMemory && gapScheduled) {
+    element = opposite;
+  } else if (paddleMemory) {
+    // Taps are opposite-paddle bits after an element, any press after a hold-off
+    element = gapScheduled ? opposite : ((paddleMemory & MEMORY_DOT) ? '.' : '-');
+  } else if (dotPaddle) {
+    element = '.';
+  } else if (dashPaddle) {
+    element = '-';
+  } else if (autospace && gapScheduled) {
+    // No paddle for an element gap: hold off to the character boundary
+    nextElementTime = characterTime;
+    gapScheduled = false;
+    squeezeMemory = false;
+    return '\0';
+  } else {
+    // No paddle: the next press starts at once
+    nextElementTime = now;
+    gapScheduled = false;
+    squeezeMemory = false;
+    paddleMemory = 0;
+    return '\0';
+  }
+  squeezeMemory = Policy::SQUEEZE_MEMORY && both;
+  paddleMemory = 0;
+  memoryArmed = ~closed & memoryEnabled;
+  return element;
+}
+
+/**
+ * @brief Collects the elements of one character; it ends at the boundary
+ *        given with the last key up, the word at a gap since that key up.
+ */
+struct DecoderState {
+  unsigned long releaseTime;       // Last key up
+  unsigned long characterTime;     // The sequence is complete from here
+  uint8_t length;                  // Elements in sequence
+  bool wordPending;                // A character was decoded and no word space followed yet
+  char sequence[MAX_SEQUENCE_LENGTH + 1];
+
+  void reset();
+  void append(char element);
+  // Key up at now; boundary is the KeyerState::characterTime of the
+  // element, or now plus the character gap for a hand key.
+  void keyUp(unsigned long now, unsigned long boundary);
+
+  // Call while the key is up, and before a new press is taken: returns
+  // the decoded character once characterTime is reached, then ' ' once
+  // the gap reaches wordGap, otherwise '\0'.
+  char poll(unsigned long now, unsigned long wordGap);
+
+  // Decodes and clears the sequence at once, without a following word space.
+  char take();
+
+  // Time from which poll() has something to report; false if never.
+  bool nextDeadline(unsigned long wordGap, unsigned long* deadline) const;
+};
+
+// Straight key: '.' or '-' for a press of this length, '\0' for a glitch.
+char classifyPress(unsigned long duration, unsigned long dotDuration);
+
+#endif // KEYER_H
@@ -0,0 +1,126 @@
+// Morse code table and compile-time encoder for the code practice device.
+// Fixed texts (the beacon message, the character tables behind the send
+// queue) are packed into element codes by the compiler and stored in
+// flash, so the firmware never encodes them at runtime. Everything here is
+// C++11 constexpr and builds unchanged on the AVR and on the Linux host
+// (where PROGMEM is ordinary memory), so the host tools share it.
+//
+//   MORSE_MESSAGE(GREETING, "CQ DE TEST");
+//   uint8_t code = pgm_read_byte(&GREETING.codes[i]); // MORSE_CODE_NONE ends it
+//
+// A character without Morse code stops the build with a static_assert.
+
+#ifndef MORSE_ENCODE_H
+#define MORSE_ENCODE_H
+
+#include <stdint.h>
+
+#if defined(ARDUINO)
+#include <avr/pgmspace.h>
+#else
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#endif
+
+// --- Morse Code Lookup Table (index 0-25 = A-Z, 26-35 = 0-9) ---
+constexpr const char* MORSE_ALPHABET[] = {
+  ".-", "-...", "-.-.", "-..", ".", "..-.", "--.", "....", "..", ".---",
+  "-.-", ".-..", "--", "-.", "---", ".--.", "--.-", ".-.", "...", "-",
+  "..-", "...-", ".--", "-..-", "-.--", "--..",
+  "-----", ".----", "..---", "...--", "....-", ".....", "-....", "--...",
+  "---..", "----."
+};
+
+// --- Punctuation and prosigns, each character next to its pattern ---
+// The WinKeyer 2 prosign keys are included: < = AR, > = SK, [ = AS,
+// ] = KN and \ = DN share their pattern with + & ( /, which the decoder
+// prints for them. The characters are in flash: read them with
+// pgm_read_byte().
+constexpr char MORSE_PUNCTUATION[] PROGMEM = ".,?'!/()&:;=+-_\"$@<>[]\\";
+constexpr const char* MORSE_PUNCTUATION_PATTERNS[] = {
+  ".-.-.-", "--..--", "..--..", ".----.", "-.-.--", "-..-.", "-.--.", "-.--.-",
+  ".-...", "---...", "-.-.-.", "-...-", ".-.-.", "-....-", "..--.-", ".-..-.",
+  "...-..-", ".--.-.", ".-.-.", "...-.-", ".-...", "-.--.", "-..-."
+};
+const int MORSE_PUNCTUATION_COUNT = sizeof(MORSE_PUNCTUATION) - 1;
+static_assert(sizeof(MORSE_PUNCTUATION_PATTERNS) / sizeof(MORSE_PUNCTUATION_PATTERNS[0]) == MORSE_PUNCTUATION_COUNT,
+              "one pattern per MORSE_PUNCTUATION character");
+
+// Packed element codes: one byte per character, elements from bit 0 up
+// (1 = dash) and a sentinel bit above the last one, so "-.." is 0b1001.
+// A code is played by shifting it right until only the sentinel is left.
+const uint8_t MORSE_CODE_NONE = 0x00;        // Not encodable; ends a MORSE_MESSAGE
+const uint8_t MORSE_CODE_WORD_SPACE = 0x01;  // Sentinel only: no elements
+
+/**
+ * @brief Packs a dot/dash pattern; length counts the elements done so far.
+ */
+constexpr uint8_t morsePatternCode(const char* pattern, uint8_t length = 0) {
+  return *pattern == '\0' ? (uint8_t)(1 << length)
+      : (uint8_t)(((*pattern == '-' ? 1 : 0) << length) | morsePatternCode(pattern + 1, length + 1));
+}
+
+constexpr uint8_t morsePunctuationCode(char c, int index = 0) {
+  return index == MORSE_PUNCTUATION_COUNT ? MORSE_CODE_NONE
+      : MORSE_PUNCTUATION[index] == c ? morsePatternCode(MORSE_PUNCTUATION_PATTERNS[index])
+      : morsePunctuationCode(c, index + 1);
+}
+
+/**
+ * @brief Packed code of a letter (either case), digit or MORSE_PUNCTUATION
+ *        character, MORSE_CODE_WORD_SPACE for ' ', otherwise
+ *        MORSE_CODE_NONE.
+ */
+constexpr uint8_t morseCode(char c) {
+  return c == ' ' ? MORSE_CODE_WORD_SPACE
+      : (c >= 'a' && c <= 'z') ? morsePatternCode(MORSE_ALPHABET[c - 'a'])
+      : (c >= 'A' && c <= 'Z') ? morsePatternCode(MORSE_ALPHABET[c - 'A'])
+      : (c >= '0' && c <= '9') ? morsePatternCode(MORSE_ALPHABET[26 + (c - '0')])
+      : morsePunctuationCode(c);
+}
+
+constexpr bool morseEncodable(const char* text) {
+  return *text == '\0' || (morseCode(*text) != MORSE_CODE_NONE && morseEncodable(text + 1));
+}
+
+// =========================================================================
+// COMPILE-TIME MESSAGES
+// =========================================================================
+// C++11 has no std::index_sequence (and the AVR toolchain no <utility>),
+// so MorseIndexRange<N> builds the pack 0..N-1 that morseEncodeMessage()
+// expands over the characters of the literal.
+
+template <unsigned... I>
+struct MorseIndices {};
+
+template <unsigned N, unsigned... I>
+struct MorseIndexRange : MorseIndexRange<N - 1, N - 1, I...> {};
+
+template <unsigned... I>
+struct MorseIndexRange<0, I...> {
+  typedef MorseIndices<I...> type;
+};
+
+/**
+ * @brief Packed codes of one message, MORSE_CODE_NONE after the last one.
+ */
+template <unsigned N>
+struct MorseMessage {
+  uint8_t codes[N + 1];
+};
+
+template <class Text, unsigned... I>
+constexpr MorseMessage<sizeof...(I)> morseEncodeMessage(MorseIndices<I...>) {
+  return {{ morseCode(Text::text()[I])..., MORSE_CODE_NONE }};
+}
+
+// Defines name as a MorseMessage in flash holding the packed codes of
+// literal, a string literal or constexpr char array; read it with
+// pgm_read_byte().
+#define MORSE_MESSAGE(name, literal) \
+  static_assert(morseEncodable(literal), "MORSE_MESSAGE " #name ": character without Morse code"); \
+  struct name##_Text { static constexpr const char* text() { return literal; } }; \
+  const MorseMessage<sizeof(literal) - 1> name PROGMEM = \
+      morseEncodeMessage<name##_Text>(MorseIndexRange<sizeof(literal) - 1>::type())
+
+#endif // MORSE_ENCODE_H
@@ -0,0 +1,179 @@
+// TX ring overflow check for a Linux host.
+// Boots the keyer core on the native HAL (hal_native.cpp) with the UART
+// limited to DRAIN_BAUD, then swings the pot between two speeds every
+// SWING_MICROS so the core queues speed reports far faster than they can
+// leave and the TX ring overflows. Once the swinging stops the ring is left
+// to drain. The same run with an instant UART gives the reference text, and
+// what arrived is checked against the policy the core is built with
+// (TX_OVERFLOW_POLICY, see "cw practice.cpp"):
+//   TX_DROP_NEWEST     - the reference with bytes cut out, starting with
+//                        the first ring's worth unchanged
+//   TX_DROP_OLDEST     - the reference with bytes cut out, ending with the
+//                        last ring's worth unchanged
+//   TX_COALESCE_STATUS - whole reference lines only, in order, ending with
+//                        the last speed report
+// The exit status is 1 if the output breaks the policy or nothing was lost.
+//
+// Built as cwoverflow_newest, cwoverflow_oldest and cwoverflow_coalesce by
+// CMakeLists.txt, one per policy, and run by ctest; on its own:
+//   build/cwoverflow_coalesce
+
+#if !defined(ARDUINO)
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "hal.h"
+#include "host_harness.h"
+
+// The sketch's policy numbers; CMakeLists.txt sets TX_OVERFLOW_POLICY per
+// build and the sketch defaults to TX_COALESCE_STATUS
+#ifndef TX_OVERFLOW_POLICY
+#define TX_OVERFLOW_POLICY 2
+#endif
+
+// =========================================================================
+// OVERFLOW CONFIGURATION
+// =========================================================================
+const unsigned long DRAIN_BAUD = 2400;    // About 4 ms a byte
+const unsigned long SWING_MICROS = 10000; // A speed report every 10 ms
+const int SWINGS = 100;
+const int POT_LOW = 200;                  // Far enough apart to beat POT_HYSTERESIS
+const int POT_HIGH = 800;
+const unsigned long DRAIN_MICROS = 3000000; // Time left for the ring to empty
+const size_t RING_BYTES = 255;            // TX_RING_SIZE - 1 bytes can wait
+const unsigned long LOOP_MICROS = 20;     // Virtual cost of one loop() pass
+
+#if TX_OVERFLOW_POLICY == 0
+const char* const POLICY_NAME = "TX_DROP_NEWEST";
+#elif TX_OVERFLOW_POLICY == 1
+const char* const POLICY_NAME = "TX_DROP_OLDEST";
+#else
+const char* const POLICY_NAME = "TX_COALESCE_STATUS";
+#endif
+
+// =========================================================================
+// EXECUTION
+// =========================================================================
+
+/**
+ * @brief Runs loop() every LOOP_MICROS for microseconds and returns what
+ *        reached the host.
+ */
+std::string runFor(unsigned long microseconds) {
+  std::string output;
+  for (unsigned long elapsed = 0; elapsed < microseconds; elapsed += LOOP_MICROS) {
+    loop();
+    halNativeAdvance(LOOP_MICROS);
+    output += drainOutput();
+  }
+  return output;
+}
+
+/**
+ * @brief Boots the core with the UART draining at baud (0 = instantly),
+ *        swings the pot and returns everything that was sent.
+ */
+std::string runCase(unsigned long baud) {
+  halNativeSerialRate(baud);
+  halNativeReset();
+  halNativeSetPot(POT_LOW);
+  setup();
+  std::string output = drainOutput();
+  for (int swing = 0; swing < SWINGS; swing++) {
+    halNativeSetPot(swing % 2 ? POT_LOW : POT_HIGH);
+    output += runFor(SWING_MICROS);
+  }
+  output += runFor(DRAIN_MICROS);
+  halNativeSerialRate(0);
+  return output;
+}
+
+/**
+ * @brief True if every byte of part appears in whole in the same order.
+ */
+bool isSubsequence(const std::string& part, const std::string& whole) {
+  size_t next = 0;
+  for (size_t i = 0; i < whole.size() && next < part.size(); i++) {
+    if (whole[i] == part[next]) next++;
+  }
+  return next == part.size();
+}
+
+/**
+ * @brief Splits text after every '\n'; a last line without one is kept.
+ */
+std::vector<std::string> splitLines(const std::string& text) {
+  std::vector<std::string> lines;
+  size_t start = 0;
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '\n') {
+      lines.push_back(text.substr(start, i + 1 - start));
+      start = i + 1;
+    }
+  }
+  if (start < text.size()) lines.push_back(text.substr(start));
+  return lines;
+}
+
+/**
+ * @brief True if the lines of output are reference lines, in order.
+ */
+bool wholeLinesOnly(const std::string& output, const std::string& reference) {
+  std::vector<std::string> got = splitLines(output);
+  std::vector<std::string> sent = splitLines(reference);
+  size_t next = 0;
+  for (size_t i = 0; i < sent.size() && next < got.size(); i++) {
+    if (sent[i] == got[next]) next++;
+  }
+  return next == got.size();
+}
+
+bool endsWith(const std::string& text, const std::string& tail) {
+  return text.size() >= tail.size() && text.compare(text.size() - tail.size(), tail.size(), tail) == 0;
+}
+
+// =========================================================================
+// MAIN
+// =========================================================================
+
+int main() {
+  std::string reference = runCase(0);
+  std::string output = runCase(DRAIN_BAUD);
+  printf("%s at %lu baud: %zu of %zu bytes arrived\n", POLICY_NAME, DRAIN_BAUD,
+         output.size(), reference.size());
+
+  int failures = 0;
+  if (output.size() >= reference.size()) {
+    printf("FAIL nothing was lost, the ring never overflowed\n");
+    failures++;
+  }
+  if (TX_OVERFLOW_POLICY == 2) {
+    std::vector<std::string> lines = splitLines(reference);
+    if (!wholeLinesOnly(output, reference)) {
+      printf("FAIL a line arrived cut short or out of order\n");
+      failures++;
+    }
+    if (!endsWith(output, lines.back())) {
+      printf("FAIL the last speed report was lost\n");
+      failures++;
+    }
+  } else {
+    if (!isSubsequence(output, reference)) {
+      printf("FAIL bytes arrived that were never sent, or out of order\n");
+      failures++;
+    }
+    if (TX_OVERFLOW_POLICY == 0 && output.compare(0, RING_BYTES, reference, 0, RING_BYTES) != 0) {
+      printf("FAIL the first bytes queued were not the ones kept\n");
+      failures++;
+    }
+    if (TX_OVERFLOW_POLICY == 1 && !endsWith(output, reference.substr(reference.size() - RING_BYTES))) {
+      printf("FAIL the last bytes queued were not the ones kept\n");
+      failures++;
+    }
+  }
+  printf("%s\n", failures ? "FAIL" : "PASS");
+  return failures ? 1 : 0;
+}
+
+#endif // !ARDUINO
@@ -0,0 +1,192 @@
+// Script parsing for the host tools; see sim_script.h for the format.
+
+#if !defined(ARDUINO)
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "hal.h"
+#include "sim_script.h"
+#include "morse_encode.h"
+
+const unsigned long ADC_SETTLE_MICROS = 250; // Extra wake after a pot move so a conversion sees it
+const unsigned long RX_BYTE_MICROS = 1042;   // One byte at the 9600 baud boot rate
+const uint64_t DEFAULT_TAIL_MICROS = 5000000ULL;
+const uint64_t BUTTON_DOWN_MICROS = 100000;   // Memory button press and release
+const uint64_t BUTTON_UP_MICROS = 150000;
+
+void scriptClear(Script& script) {
+  script.events.clear();
+  script.endTime = 0;
+  script.bounceCount = 0;
+  script.bounceMicros = 0;
+  script.keys = 0;
+}
+
+void addEvent(Script& script, uint64_t time, EventType type, int value) {
+  Event event = { time, (unsigned long)script.events.size(), type, value };
+  script.events.push_back(event);
+}
+
+/**
+ * @brief Adds a contact change, followed by bounce if configured. The
+ *        contacts chatter back to the previous state and settle on keys.
+ */
+void addKeys(Script& script, uint64_t time, uint8_t keys) {
+  uint8_t previous = script.keys;
+  addEvent(script, time, EV_KEYS, keys);
+  for (unsigned long i = 1; i <= script.bounceCount && previous != keys; i++) {
+    addEvent(script, time + (2 * i - 1) * script.bounceMicros, EV_KEYS, previous);
+    addEvent(script, time + 2 * i * script.bounceMicros, EV_KEYS, keys);
+  }
+  script.keys = keys;
+}
+
+const char* scriptMorseFor(char c) {
+  if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+  if (c >= 'A' && c <= 'Z') return MORSE_ALPHABET[c - 'A'];
+  if (c >= '0' && c <= '9') return MORSE_ALPHABET[26 + c - '0'];
+  return NULL;
+}
+
+/**
+ * @brief Keys text at wpm. Straight key: each element is held for its
+ *        length. Paddles: the matching paddle is held for half a dot, the
+ *        keyer times the element itself and the next press waits for its gap.
+ */
+void addText(Script& script, uint64_t time, int wpm, const char* text, bool paddles) {
+  uint64_t dot = 1200000ULL / wpm;
+  for (; *text; text++) {
+    if (*text == ' ') {
+      time += 4 * dot; // Character gap already elapsed: 3 + 4 = 7 dots
+      continue;
+    }
+    const char* pattern = scriptMorseFor(*text);
+    if (pattern == NULL) continue;
+    for (; *pattern; pattern++) {
+      uint64_t length = (*pattern == '-') ? 3 * dot : dot;
+      if (paddles) {
+        addKeys(script, time, (*pattern == '-') ? KEY_DASH : KEY_DOT);
+        addKeys(script, time + dot / 2, 0);
+      } else {
+        addKeys(script, time, KEY_STRAIGHT);
+        addKeys(script, time + length, 0);
+      }
+      time += length + dot;
+    }
+    time += 2 * dot;
+  }
+}
+
+uint8_t parseKeys(const char* name) {
+  if (strcmp(name, "dot") == 0) return KEY_DOT;
+  if (strcmp(name, "dash") == 0) return KEY_DASH;
+  if (strcmp(name, "both") == 0) return KEY_DOT | KEY_DASH;
+  if (strcmp(name, "straight") == 0) return KEY_STRAIGHT;
+  return 0;
+}
+
+bool scriptParseLine(Script& script, const char* line) {
+  const char* text = line + strspn(line, " \t");
+  if (*text == '\0' || *text == '#') return true;
+
+  unsigned long a, b;
+  if (sscanf(text, "bounce %lu %lu", &a, &b) == 2) {
+    script.bounceCount = a;
+    script.bounceMicros = b;
+    return true;
+  }
+
+  double ms;
+  char command[16];
+  int consumed = 0;
+  if (sscanf(text, "%lf %15s %n", &ms, command, &consumed) < 2 || ms < 0) return false;
+  uint64_t time = (uint64_t)(ms * 1000.0 + 0.5);
+  const char* rest = text + consumed;
+  int wpm, offset = 0;
+  double endMs;
+  int from, to;
+
+  if (strcmp(command, "keys") == 0) {
+    addKeys(script, time, parseKeys(rest));
+  } else if (strcmp(command, "straight") == 0 || strcmp(command, "paddle") == 0) {
+    if (sscanf(rest, "%d %n", &wpm, &offset) != 1 || wpm <= 0) return false;
+    addText(script, time, wpm, rest + offset, command[0] == 'p');
+  } else if (strcmp(command, "pot") == 0) {
+    if (sscanf(rest, "%d", &from) != 1) return false;
+    addEvent(script, time, EV_POT, from);
+    addEvent(script, time + ADC_SETTLE_MICROS, EV_WAKE, 0);
+  } else if (strcmp(command, "sweep") == 0) {
+    if (sscanf(rest, "%lf %d %d", &endMs, &from, &to) != 3 || endMs <= ms) return false;
+    for (double t = ms; t <= endMs; t += 10.0) {
+      uint64_t at = (uint64_t)(t * 1000.0 + 0.5);
+      addEvent(script, at, EV_POT, from + (int)((to - from) * (t - ms) / (endMs - ms)));
+      addEvent(script, at + ADC_SETTLE_MICROS, EV_WAKE, 0);
+    }
+  } else if (strcmp(command, "serial") == 0) {
+    for (; *rest; rest++, time += RX_BYTE_MICROS) addEvent(script, time, EV_RX, (uint8_t)*rest);
+    addEvent(script, time, EV_RX, '\r');
+  } else if (strcmp(command, "button") == 0) {
+    if (sscanf(rest, "%d", &from) != 1 || from <= 0) return false;
+    for (int i = 0; i < from; i++, time += BUTTON_DOWN_MICROS + BUTTON_UP_MICROS) {
+      addKeys(script, time, script.keys | KEY_MEMORY);
+      addKeys(script, time + BUTTON_DOWN_MICROS, script.keys & ~KEY_MEMORY);
+    }
+  } else if (strcmp(command, "end") == 0) {
+    addEvent(script, time, EV_END, 0);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool eventBefore(const Event& a, const Event& b) {
+  return a.time != b.time ? a.time < b.time : a.order < b.order;
+}
+
+void scriptFinish(Script& script) {
+  std::sort(script.events.begin(), script.events.end(), eventBefore);
+  script.endTime = script.events.empty() ? DEFAULT_TAIL_MICROS : script.events.back().time + DEFAULT_TAIL_MICROS;
+  for (size_t i = 0; i < script.events.size(); i++) {
+    if (script.events[i].type == EV_END) {
+      script.endTime = script.events[i].time;
+      break;
+    }
+  }
+}
+
+bool scriptLoad(Script& script, const char* path) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  char line[512];
+  int lineNumber = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file) != NULL) {
+    lineNumber++;
+    line[strcspn(line, "\r\n")] = '\0';
+    ok = scriptParseLine(script, line);
+  }
+  fclose(file);
+  if (!ok) {
+    fprintf(stderr, "%s:%d: cannot parse \"%s\"\n", path, lineNumber, line);
+    return false;
+  }
+  scriptFinish(script);
+  return true;
+}
+
+void scriptApply(const Event& event) {
+  if (event.type == EV_KEYS) {
+    halNativeSetKeys((uint8_t)event.value);
+  } else if (event.type == EV_POT) {
+    halNativeSetPot(event.value);
+  } else if (event.type == EV_RX) {
+    char text[2] = { (char)event.value, '\0' };
+    halNativeReceive(text);
+  }
+}
+
+#endif // !ARDUINO
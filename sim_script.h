@@ -0,0 +1,58 @@
+// Input scripts for the host tools (simulator.cpp, wcet.cpp).
+// A script is a list of timed inputs for the native HAL, one per line,
+// times in milliseconds from boot:
+//   # comment
+//   <ms> keys none|dot|dash|both|straight   set the contacts directly
+//   <ms> straight <wpm> <text>              key text on the straight key
+//   <ms> paddle <wpm> <text>                key text with single-paddle presses
+//   <ms> pot <0..1023>                      move the speed pot
+//   <ms> sweep <end ms> <from> <to>         ramp the pot in 10 ms steps
+//   <ms> serial <text>                      send a host line (CR appended)
+//   <ms> button <count>                     press the memory button count times
+//   <ms> end                                stop the run (default: 5 s after the last event)
+//   bounce <count> <us>                     later key edges chatter count times, us apart
+
+#ifndef SIM_SCRIPT_H
+#define SIM_SCRIPT_H
+
+#include <stdint.h>
+#include <vector>
+
+enum EventType {
+  EV_KEYS,    // value = KEY_* bits
+  EV_POT,     // value = 0..1023
+  EV_RX,      // value = one received byte
+  EV_WAKE,    // no input change, only forces a loop() pass
+  EV_END
+};
+
+struct Event {
+  uint64_t time;       // Virtual microseconds
+  unsigned long order; // Script order, keeps equal times stable
+  EventType type;
+  int value;
+};
+
+struct Script {
+  std::vector<Event> events;
+  uint64_t endTime;
+  unsigned long bounceCount;
+  unsigned long bounceMicros;
+  uint8_t keys;        // Contact state the script has reached so far
+};
+
+void scriptClear(Script& script);
+
+// Adds one script line; returns false on a syntax error.
+bool scriptParseLine(Script& script, const char* line);
+
+// Reads a whole file and finishes the script; errors go to stderr.
+bool scriptLoad(Script& script, const char* path);
+
+// Sorts the events and works out endTime; call once after parsing.
+void scriptFinish(Script& script);
+
+// Hands one input event to the native HAL.
+void scriptApply(const Event& event);
+
+#endif // SIM_SCRIPT_H
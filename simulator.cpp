@@ -0,0 +1,224 @@
+// Deterministic host simulator for the code practice device.
+// Runs the unmodified setup()/loop() from "cw practice.cpp" on the native
+// HAL (hal_native.cpp) against a virtual clock. Each pass of loop() costs
+// LOOP_MICROS of virtual time; when idleBudget() reports that nothing is
+// due, the clock jumps straight to the next deadline or scripted input, so
+// an hour of practice replays in a fraction of a second.
+//
+// Built as cwsim by CMakeLists.txt; run on a Linux host:
+//   build/cwsim session.txt [-o trace.txt] [--expect golden.txt] [--loop-us N]
+//               [--boots N]
+//
+// The input script format is described in sim_script.h.
+//
+// The trace has one line per output change, time in microseconds:
+//   <us> ON | OFF                           key output / sidetone gate
+//   <us> FREQ <hz>                          sidetone frequency
+//   <us> TX "<bytes>"                       serial output, non-printables as \xNN
+// With --expect the trace is compared with a golden file; the first
+// difference is reported and the exit status is 1. --boots N replays the
+// session N times in one process, each from halNativeReset(), and fails
+// unless every boot traces the same: core state that survives the reset
+// (coreReset() in "cw practice.cpp") shows up as a difference.
+// tests/run_golden.sh replays the scripts in tests/sim against their
+// golden traces (ctest runs it).
+
+#if !defined(ARDUINO)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "hal.h"
+#include "sim_script.h"
+
+// =========================================================================
+// SIMULATOR CONFIGURATION
+// =========================================================================
+unsigned long LOOP_MICROS = 20;          // Virtual cost of one busy loop() pass
+
+// =========================================================================
+// TRACE
+// =========================================================================
+
+std::vector<std::string> trace;
+bool lastKey = false;
+unsigned int lastFrequency = 0;
+
+void traceLine(uint64_t time, const char* text) {
+  char line[64];
+  snprintf(line, sizeof(line), "%llu ", (unsigned long long)time);
+  trace.push_back(std::string(line) + text);
+}
+
+/**
+ * @brief Records every output that changed during the last loop() pass.
+ */
+void traceOutputs(uint64_t time) {
+  unsigned int frequency = halNativeSidetoneFrequency();
+  if (frequency != lastFrequency) {
+    char text[24];
+    snprintf(text, sizeof(text), "FREQ %u", frequency);
+    traceLine(time, text);
+    lastFrequency = frequency;
+  }
+  bool key = halNativeKeyOutput();
+  if (key != lastKey) {
+    traceLine(time, key ? "ON" : "OFF");
+    lastKey = key;
+  }
+
+  char buffer[256];
+  std::string text;
+  while (halNativeTakeOutput(buffer, sizeof(buffer)) > 0) {
+    for (const char* c = buffer; *c; c++) {
+      if (*c >= ' ' && *c <= '~' && *c != '"' && *c != '\\') {
+        text += *c;
+      } else {
+        char escape[8];
+        snprintf(escape, sizeof(escape), "\\x%02X", (uint8_t)*c);
+        text += escape;
+      }
+    }
+  }
+  if (!text.empty()) traceLine(time, ("TX \"" + text + "\"").c_str());
+}
+
+/**
+ * @brief Compares the trace with a golden file; prints the first mismatch.
+ */
+bool compareGolden(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  char line[4096];
+  size_t index = 0;
+  bool same = true;
+  while (same && fgets(line, sizeof(line), file) != NULL) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (index >= trace.size() || trace[index] != line) {
+      fprintf(stderr, "trace differs at line %lu\n  expected: %s\n  actual:   %s\n",
+              (unsigned long)index + 1, line,
+              index < trace.size() ? trace[index].c_str() : "(end of trace)");
+      same = false;
+    }
+    index++;
+  }
+  if (same && index < trace.size()) {
+    fprintf(stderr, "trace differs at line %lu\n  expected: (end of file)\n  actual:   %s\n",
+            (unsigned long)index + 1, trace[index].c_str());
+    same = false;
+  }
+  fclose(file);
+  return same;
+}
+
+// =========================================================================
+// EXECUTION
+// =========================================================================
+
+/**
+ * @brief Boots the core and replays the script into a fresh trace;
+ *        returns the number of loop() passes.
+ */
+unsigned long runSession(const Script& script) {
+  const std::vector<Event>& events = script.events;
+  uint64_t endTime = script.endTime;
+  unsigned long passes = 0;
+  size_t next = 0;
+
+  trace.clear();
+  lastKey = false;
+  lastFrequency = 0;
+  halNativeReset();
+  setup();
+  traceOutputs(0);
+
+  while (halNativeTime() < endTime) {
+    uint64_t now = halNativeTime();
+    for (; next < events.size() && events[next].time <= now; next++) scriptApply(events[next]);
+
+    loop();
+    passes++;
+    now = halNativeTime(); // halSleep() may have moved the clock
+    traceOutputs(now);
+
+    // Skip ahead to whatever comes first: a deadline, an input or the end
+    unsigned long budget = idleBudget();
+    uint64_t wake = now + (budget > LOOP_MICROS ? budget : LOOP_MICROS);
+    if (next < events.size() && events[next].time < wake) wake = events[next].time;
+    if (wake > endTime) wake = endTime;
+    if (wake > now) halNativeAdvance((unsigned long)(wake - now));
+  }
+  return passes;
+}
+
+// =========================================================================
+// MAIN
+// =========================================================================
+
+int main(int argc, char** argv) {
+  const char* scriptPath = NULL;
+  const char* outputPath = NULL;
+  const char* goldenPath = NULL;
+  unsigned long boots = 1;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outputPath = argv[++i];
+    } else if (strcmp(argv[i], "--expect") == 0 && i + 1 < argc) {
+      goldenPath = argv[++i];
+    } else if (strcmp(argv[i], "--loop-us") == 0 && i + 1 < argc) {
+      LOOP_MICROS = strtoul(argv[++i], NULL, 10);
+      if (LOOP_MICROS == 0) LOOP_MICROS = 1;
+    } else if (strcmp(argv[i], "--boots") == 0 && i + 1 < argc) {
+      boots = strtoul(argv[++i], NULL, 10);
+      if (boots == 0) boots = 1;
+    } else if (scriptPath == NULL) {
+      scriptPath = argv[i];
+    } else {
+      scriptPath = NULL;
+      break;
+    }
+  }
+  if (scriptPath == NULL) {
+    fprintf(stderr, "usage: %s script [-o trace] [--expect golden] [--loop-us N] [--boots N]\n", argv[0]);
+    return 2;
+  }
+  Script script;
+  scriptClear(script);
+  if (!scriptLoad(script, scriptPath)) return 2;
+  clock_t started = clock();
+  unsigned long passes = 0;
+  std::vector<std::string> firstTrace;
+  for (unsigned long boot = 1; boot <= boots; boot++) {
+    passes += runSession(script);
+    if (boot == 1) {
+      firstTrace = trace;
+    } else if (trace != firstTrace) {
+      fprintf(stderr, "boot %lu traces differently from boot 1: core state survived halNativeReset()\n", boot);
+      return 1;
+    }
+  }
+
+  FILE* output = stdout;
+  if (outputPath != NULL && (output = fopen(outputPath, "w")) == NULL) {
+    fprintf(stderr, "cannot write %s\n", outputPath);
+    return 2;
+  }
+  if (goldenPath == NULL || outputPath != NULL) {
+    for (size_t i = 0; i < trace.size(); i++) fprintf(output, "%s\n", trace[i].c_str());
+  }
+  if (output != stdout) fclose(output);
+
+  fprintf(stderr, "%.3f s simulated in %lu passes, %.3f s host time\n",
+          boots * (script.endTime / 1e6), passes, (double)(clock() - started) / CLOCKS_PER_SEC);
+
+  if (goldenPath != NULL && !compareGolden(goldenPath)) return 1;
+  return 0;
+}
+
+#endif // !ARDUINO
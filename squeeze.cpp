@@ -0,0 +1,175 @@
+// Squeeze and paddle memory timing check for the paddle keyer on the
+// native HAL.
+// Each case is a paddle timeline in dot units (at 20 WPM, one dot =
+// 60 ms) with a paddle memory setting. It is replayed from a fresh boot
+// (halNativeReset()) in each paddle keying style, and the elements the keyer
+// sends are compared with the reference behaviour written next to the
+// case:
+//   A (Mode A)  - the next element follows the paddles closed when the
+//                 current element and its gap end.
+//   B (Mode B)  - if both paddles were closed together at any time during
+//                 the element or its gap, the opposite element is sent next.
+//   U (Ultimatic) - while both are closed the paddle pressed last repeats.
+//   S (Single lever) - while both are closed the paddle pressed first repeats.
+//   Memory      - a press of the opposite paddle that starts during the
+//                 element or its gap is sent next (PADMEM DOT / DASH / BOTH).
+// Events closer together than a loop() pass exercise the paddle latches.
+// Prints one line per case and style; the exit status is 1 on any mismatch.
+// Modes are switched with the MODE command, so it links against the core
+// built with KEYER_RUNTIME_MODES 1 (cwcore_runtime in CMakeLists.txt).
+//
+// Built as cwsqueeze by CMakeLists.txt and run by ctest; on its own:
+//   build/cwsqueeze
+
+#if !defined(ARDUINO)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "hal.h"
+#include "host_harness.h"
+
+// =========================================================================
+// CASES
+// =========================================================================
+const int CASE_WPM = 20;
+const double DOT_MICROS = 1200000.0 / CASE_WPM;
+const unsigned long LOOP_MICROS = 20;    // Virtual cost of one loop() pass
+const double TAIL_DOTS = 20;             // Run on after the last event
+
+struct SqueezeCase {
+  const char* name;
+  const char* memory;    // PADMEM argument
+  const char* timeline;  // "<dots> <none|dot|dash|both>; ..."
+  const char* expected[4]; // Elements keyed in each of STYLES
+};
+
+const SqueezeCase CASES[] = {
+  // Squeeze timing without paddle memory
+  { "dot held for two elements",       "OFF",  "0 dot; 3.5 none",                           { "..", "..", "..", ".." } },
+  { "dash held for two elements",      "OFF",  "0 dash; 5.5 none",                          { "--", "--", "--", "--" } },
+  { "squeeze released in 4th element", "OFF",  "0 both; 8.5 none",                          { ".-.-", ".-.-.", "---", "....." } },
+  { "squeeze released in 1st element", "OFF",  "0 both; 0.5 none",                          { ".", ".-", "-", "." } },
+  { "dash first, then squeeze",        "OFF",  "0 dash; 1 both; 4.5 none",                  { "-.", "-.-", "-.", "--" } },
+  { "dot tapped inside a dash",        "OFF",  "0 dash; 1 both; 1.5 dash; 2 none",          { "-", "-.", "-", "-" } },
+  { "dot tapped after dash release",   "OFF",  "0 dash; 0.5 none; 1 dot; 1.2 none",         { "-", "-", "-", "-" } },
+  { "dash tapped in the gap",          "OFF",  "0 dot; 1.2 both; 1.4 dot; 5.5 none",        { "...", ".-", "...", "..." } },
+  { "dash pressed over a held dot",    "OFF",  "0 dot; 1.5 both; 4.5 dot; 7.5 none",        { ".-.", ".-.", ".-.", "...." } },
+  { "squeeze shorter than a pass",     "OFF",  "0 dash; 0.5 none; 1.0001 both; 1.0002 none", { "-", "-.", "-", "-" } },
+  { "dot shorter than a pass",         "OFF",  "0.0001 dot; 0.0002 none",                   { ".", ".", ".", "." } },
+  // Dot and dash memory
+  { "held squeeze is not a tap",       "BOTH", "0 both; 8.5 none",                          { ".-.-", ".-.-.", "---", "....." } },
+  { "dot tapped inside a dash",        "BOTH", "0 dash; 0.5 none; 1 dot; 1.2 none",         { "-.", "-.", "-.", "-." } },
+  { "dot tap shorter than a pass",     "BOTH", "0 dash; 1.0001 both; 1.0002 dash; 6.5 none", { "-.-", "-.-", "-.-", "-.-" } },
+  { "dot tap, dot memory off",         "DASH", "0 dash; 1.0001 both; 1.0002 dash; 6.5 none", { "--", "-.-", "--", "--" } },
+  { "dash tapped inside a dot",        "DASH", "0 dot; 0.5 both; 0.6 dot; 3.5 none",        { ".-", ".-", ".-", ".-" } },
+  { "dash tap, dash memory off",       "DOT",  "0 dot; 0.5 both; 0.6 dot; 3.5 none",        { "..", ".-", "..", ".." } },
+  { "dash tapped in the gap",          "BOTH", "0 dot; 0.5 none; 1.2 dash; 1.4 none",       { ".-", ".-", ".-", ".-" } },
+  { "same paddle tapped in the gap",   "BOTH", "0 dot; 0.5 none; 1.2 dot; 1.4 none",        { ".", ".", ".", "." } },
+};
+const int CASE_COUNT = sizeof(CASES) / sizeof(CASES[0]);
+
+// Paddle keying styles, as MODE arguments, and their column labels
+const char* const STYLES[] = { "IAMBIC_A", "IAMBIC_B", "ULTIMATIC", "SINGLE_LEVER" };
+const char* const STYLE_LABELS[] = { "A", "B", "U", "S" };
+const int STYLE_COUNT = 4;
+
+struct KeyEvent {
+  uint64_t time;
+  uint8_t keys;
+};
+
+uint8_t keysNamed(const char* name) {
+  if (strcmp(name, "dot") == 0) return KEY_DOT;
+  if (strcmp(name, "dash") == 0) return KEY_DASH;
+  if (strcmp(name, "both") == 0) return KEY_DOT | KEY_DASH;
+  return 0;
+}
+
+std::vector<KeyEvent> parseTimeline(const char* timeline, uint64_t start) {
+  std::vector<KeyEvent> events;
+  const char* text = timeline;
+  while (*text) {
+    double dots;
+    char name[8];
+    int consumed = 0;
+    if (sscanf(text, " %lf %7[a-z] %n", &dots, name, &consumed) < 2) break;
+    KeyEvent event = { start + (uint64_t)(dots * DOT_MICROS + 0.5), keysNamed(name) };
+    events.push_back(event);
+    text += consumed;
+    if (*text == ';') text++;
+  }
+  return events;
+}
+
+// =========================================================================
+// EXECUTION
+// =========================================================================
+
+/**
+ * @brief Boots the core in the given mode and returns the elements keyed
+ *        for one timeline.
+ */
+std::string runCase(const SqueezeCase& squeezeCase, const char* mode) {
+  halNativeReset();
+  setup();
+  char command[64];
+  snprintf(command, sizeof(command), "MODE %s\rPADMEM %s\rWPM %d\r", mode, squeezeCase.memory, CASE_WPM);
+  halNativeReceive(command);
+  uint64_t start = 500000;
+  while (halNativeTime() < start) {
+    loop();
+    halNativeAdvance(LOOP_MICROS);
+  }
+  if (drainOutput().find("ERR") != std::string::npos) return "(MODE rejected)";
+
+  std::vector<KeyEvent> events = parseTimeline(squeezeCase.timeline, start);
+  uint64_t end = (events.empty() ? start : events.back().time) + (uint64_t)(TAIL_DOTS * DOT_MICROS);
+  std::string elements;
+  bool key = false;
+  uint64_t keyDown = 0;
+  size_t next = 0;
+  while (halNativeTime() < end) {
+    // Every event since the last pass is applied in order, so a contact
+    // that opened again before this pass only reaches the keyer by latch
+    uint64_t now = halNativeTime();
+    for (; next < events.size() && events[next].time <= now; next++) halNativeSetKeys(events[next].keys);
+    loop();
+    drainOutput();
+    if (halNativeKeyOutput() != key) {
+      key = !key;
+      if (key) {
+        keyDown = now;
+      } else {
+        elements += (now - keyDown >= 2 * DOT_MICROS) ? '-' : '.';
+      }
+    }
+    halNativeAdvance(LOOP_MICROS);
+  }
+  return elements;
+}
+
+// =========================================================================
+// MAIN
+// =========================================================================
+
+int main() {
+  int failures = 0;
+  for (int i = 0; i < CASE_COUNT; i++) {
+    for (int style = 0; style < STYLE_COUNT; style++) {
+      const char* expected = CASES[i].expected[style];
+      std::string got = runCase(CASES[i], STYLES[style]);
+      bool pass = got == expected;
+      if (!pass) failures++;
+      printf("%s %s  %-4s %-32s %-6s", pass ? "PASS" : "FAIL", STYLE_LABELS[style], CASES[i].memory, CASES[i].name, got.c_str());
+      if (!pass) printf(" (expected %s)", expected);
+      printf("\n");
+    }
+  }
+  printf("%d of %d checks failed\n", failures, STYLE_COUNT * CASE_COUNT);
+  return failures ? 1 : 0;
+}
+
+#endif // !ARDUINO
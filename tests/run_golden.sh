@@ -0,0 +1,44 @@
+#!/bin/sh
+# Replays every simulator script in tests/sim (*.txt) and compares its
+# trace with the golden trace next to it (*.golden); see simulator.cpp.
+# A timing change in the core shows up as the first differing trace line.
+# Each script is booted twice in one process, so core state that
+# survives halNativeReset() fails the check too.
+#
+#   tests/run_golden.sh build/cwsim            check all scripts
+#   tests/run_golden.sh build/cwsim --update   rewrite the golden traces
+#
+# Exit status: 0 all match, 1 a trace differs, 2 usage or missing files.
+
+if [ $# -lt 1 ] || [ ! -x "$1" ]; then
+  echo "usage: $0 path/to/cwsim [--update]" >&2
+  exit 2
+fi
+cwsim=$1
+update=$2
+dir=$(dirname "$0")/sim
+
+errors=$(mktemp) || exit 2
+trap 'rm -f "$errors"' EXIT
+failures=0
+count=0
+for script in "$dir"/*.txt; do
+  golden=${script%.txt}.golden
+  count=$((count + 1))
+  if [ "$update" = "--update" ]; then
+    "$cwsim" "$script" -o "$golden" 2>/dev/null || exit 2
+    echo "UPDATED $golden"
+  elif [ ! -f "$golden" ]; then
+    echo "MISSING $golden" >&2
+    exit 2
+  elif "$cwsim" "$script" --boots 2 --expect "$golden" -o /dev/null 2>"$errors"; then
+    echo "PASS $script"
+  else
+    grep -v "simulated in" "$errors" >&2
+    echo "FAIL $script"
+    failures=$((failures + 1))
+  fi
+done
+[ "$update" = "--update" ] && exit 0
+echo "$failures of $count traces differ"
+[ "$failures" -eq 0 ]
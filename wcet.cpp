@@ -0,0 +1,518 @@
+// Worst-case loop() search for the keyer core on the native HAL.
+// Generates adversarial input scripts (sim_script.h format) in every
+// keying style (MODE, including AUTO) from MIN_WPM up to the core's
+// MAX_WPM: pot flapping across speed steps, paddle changes a few
+// microseconds around element and character-gap deadlines, over-long
+// sequences, contact bounce, style changes while keying and host
+// commands that complete at the same moment a character decodes. Each
+// script runs from a fresh boot (halNativeReset()) in a forked child, so a
+// crash in the core is counted rather than fatal. Every pass advances the virtual clock by its
+// modelled HAL cycles plus --core-cycles, as in benchmark.cpp, so the
+// passes of a script are the same on every run.
+//
+// Two costs are kept per pass, and the worst pass of each is reported:
+//   ns      host time of the whole loop() pass, core code included (the
+//           divisions in setSpeed(), the decoder's table scan, telemetry
+//           and COBS framing). Each script runs --repeats times (default
+//           3) and every pass keeps its shortest time, which drops host
+//           preemption. Scripts are ranked by this cost; it is reported
+//           for information only, compare it on the same machine.
+//   cycles  modelled ATmega328P cycles of the HAL calls made in the pass
+//           (cost model in hal_native.cpp). Exact and host independent,
+//           but blind to the core's own work; --limit gates on it, so
+//           the check gives the same answer on every host.
+// This is a search for expensive passes, not a WCET bound: neither figure
+// is a count of AVR cycles for the core's code, and only the inputs the
+// generator produces are tried. The search is seeded, so the same build
+// tries the same scripts. The worst script is written with -o; --replay
+// runs a script and lists the inputs that led to its worst passes.
+//
+// Built by CMakeLists.txt as cwwcet (MAX_WPM 40) and cwwcet_hs (the
+// HIGH_SPEED_MODE core, MAX_WPM 80), both with every keying style built
+// in; run on a Linux host:
+//   build/cwwcet [--trials N] [--seed S] [--repeats N] [--core-cycles N]
+//                [--limit CYCLES] [-o worst.txt]
+//   build/cwwcet --replay worst.txt
+
+#if !defined(ARDUINO)
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "hal.h"
+#include "host_harness.h"
+#include "sim_script.h"
+
+// =========================================================================
+// WCET CONFIGURATION
+// =========================================================================
+#ifndef HIGH_SPEED_MODE
+#define HIGH_SPEED_MODE 0
+#endif
+const int WCET_MIN_WPM = 5;              // MIN_WPM of the sketch
+const int WCET_MAX_WPM = HIGH_SPEED_MODE ? 80 : 40; // MAX_WPM of the core linked in
+const unsigned long F_CPU_HZ = 16000000UL;
+unsigned long coreCycles = 300;          // Virtual-clock cost of the core's own work per pass
+unsigned long repeats = 3;               // Runs per script; each pass keeps its shortest time
+const int RECENT_EVENTS = 32;            // Inputs listed before the worst pass in --replay
+const double SEGMENT_END_MS = 4000.0;    // Length of the generated part of a script
+const int POT_HYSTERESIS_GUESS = 4;      // Pot steps that just clear the core's hysteresis
+
+// Per-pass costs of one script, indexed by pass
+struct PassTrace {
+  std::vector<uint32_t> cycles;  // Modelled HAL cycles (the same on every run)
+  std::vector<uint32_t> nanos;   // Host time, shortest of the repeats
+  std::vector<uint64_t> times;   // Virtual microseconds at the start of the pass
+};
+
+// Worst passes of a script
+struct PassResult {
+  uint64_t cycles;
+  unsigned long cyclesPass;
+  uint64_t cyclesTime;
+  uint64_t nanos;
+  unsigned long nanosPass;
+  uint64_t nanosTime;
+  bool crashed;
+};
+
+// =========================================================================
+// SCRIPT GENERATOR
+// =========================================================================
+
+uint32_t rngState;
+
+uint32_t rngNext() {
+  rngState = rngState * 1664525UL + 1013904223UL;
+  return rngState >> 8;
+}
+
+int rngRange(int low, int high) {
+  return low + (int)(rngNext() % (uint32_t)(high - low + 1));
+}
+
+/**
+ * @brief Appends one formatted script line.
+ */
+void emit(std::string& script, const char* format, ...) __attribute__((format(printf, 2, 3)));
+void emit(std::string& script, const char* format, ...) {
+  char line[160];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  script += line;
+  script += '\n';
+}
+
+const char* KEY_NAMES[] = { "none", "dot", "dash", "both", "straight" };
+const char* MODES[] = { "STRAIGHT", "IAMBIC_A", "IAMBIC_B", "ULTIMATIC", "SINGLE_LEVER", "BUG", "COOTIE", "AUTO" };
+const int MODE_COUNT = sizeof(MODES) / sizeof(MODES[0]);
+const char* COMMANDS[] = { "LAT", "JIT", "PROF", "STAMP ON", "STAMP OFF", "TLM ON", "TLM OFF" };
+
+/**
+ * @brief Sends a host line timed so that its CR arrives at the given moment.
+ */
+void emitCommandAt(std::string& script, double ms, const char* command) {
+  double start = ms - strlen(command) * 1.042;
+  if (start < 0) start = 0;
+  emit(script, "%.3f serial %s", start, command);
+}
+
+/**
+ * @brief Builds one adversarial script from a seed.
+ */
+std::string generateScript(uint32_t seed) {
+  rngState = seed * 2654435761UL + 1;
+  std::string script;
+  int wpm = rngRange(WCET_MIN_WPM, WCET_MAX_WPM);
+  double dot = 1200.0 / wpm;
+  int mode = rngRange(0, MODE_COUNT - 1);
+  bool straight = mode == 0;            // Straight key only
+  bool anyKey = mode == MODE_COUNT - 1; // AUTO: paddles and straight key
+
+  emit(script, "# seed %lu", (unsigned long)seed);
+  emit(script, "0 pot %d", rngRange(0, 1023));
+  emit(script, "0 serial MODE %s", MODES[mode]);
+  emit(script, "30 serial WPM %d", wpm);
+  if (rngRange(0, 3) == 0) emit(script, "bounce %d %d", rngRange(1, 4), rngRange(20, 400));
+
+  double t = 100.0;
+  while (t < SEGMENT_END_MS) {
+    switch (rngRange(0, 5)) {
+      case 0: { // Pot flapping across the hysteresis and speed steps
+        int base = rngRange(0, 1023 - 3 * POT_HYSTERESIS_GUESS);
+        double step = 0.05 + rngRange(0, 300) / 100.0;
+        emitCommandAt(script, t, "WPM POT");
+        for (int i = 0; i < 100; i++) {
+          emit(script, "%.3f pot %d", t + i * step, base + (i & 1) * rngRange(POT_HYSTERESIS_GUESS, 3 * POT_HYSTERESIS_GUESS));
+        }
+        emitCommandAt(script, t + 100 * step + 5, "WPM 20");
+        t += 100 * step + 40;
+        dot = 60.0;
+        break;
+      }
+      case 1: { // Contact changes a few microseconds around element deadlines
+        int count = rngRange(5, 40);
+        for (int i = 0; i < count; i++) {
+          double jitter = rngRange(-200, 200) / 1000.0;
+          const char* keys = anyKey ? KEY_NAMES[rngRange(0, 4)]
+              : KEY_NAMES[straight ? (rngRange(0, 1) ? 4 : 0) : rngRange(0, 3)];
+          emit(script, "%.3f keys %s", t + i * dot + jitter, keys);
+        }
+        emit(script, "%.3f keys none", t + count * dot);
+        t += count * dot + rngRange(2, 8) * dot;
+        break;
+      }
+      case 2: { // Over-long sequence, decoded at the exact gap boundary with a command
+        int elements = rngRange(7, 12);
+        for (int i = 0; i < elements; i++) {
+          emit(script, "%.3f keys %s", t + 2 * i * dot, straight ? "straight" : "dot");
+          emit(script, "%.3f keys none", t + (2 * i + (straight ? 1 : 0.5)) * dot);
+        }
+        double gapEnd = t + (2 * elements - 1) * dot + 3 * dot + rngRange(-20, 20) / 1000.0;
+        emitCommandAt(script, gapEnd, COMMANDS[rngRange(0, 6)]);
+        t = gapEnd + rngRange(4, 10) * dot;
+        break;
+      }
+      case 3: { // Text at (or near) the keyer speed, with a speed change at a word gap
+        static const char* WORDS[] = { "PARIS", "CQ", "5NN", "TEST 73", "EEEEE", "0000" };
+        emit(script, "%.3f %s %d %s", t, straight ? "straight" : "paddle", wpm + rngRange(-1, 1), WORDS[rngRange(0, 5)]);
+        t += 60 * dot;
+        char command[16];
+        snprintf(command, sizeof(command), "WPM %d", rngRange(WCET_MIN_WPM, WCET_MAX_WPM));
+        emitCommandAt(script, t - rngRange(0, 7) * dot, command);
+        t += 10 * dot;
+        break;
+      }
+      case 4: { // Style change landing while an element or its gap runs
+        emit(script, "%.3f keys %s", t, KEY_NAMES[straight ? 4 : anyKey ? rngRange(1, 4) : rngRange(1, 3)]);
+        mode = rngRange(0, MODE_COUNT - 1);
+        char command[24];
+        snprintf(command, sizeof(command), "MODE %s", MODES[mode]);
+        emitCommandAt(script, t + rngRange(1, 40) * dot / 10, command);
+        emit(script, "%.3f keys none", t + rngRange(2, 8) * dot);
+        straight = mode == 0;
+        anyKey = mode == MODE_COUNT - 1;
+        t += 12 * dot;
+        break;
+      }
+      default: { // Host commands back to back while keying
+        emit(script, "%.3f keys %s", t, straight ? "straight" : "both");
+        char command[16];
+        snprintf(command, sizeof(command), "TONE %d", rngRange(200, 2000));
+        emitCommandAt(script, t + 20, command);
+        emitCommandAt(script, t + 40, COMMANDS[rngRange(0, 6)]);
+        emit(script, "%.3f keys none", t + 50 + rngRange(0, 100) / 10.0);
+        t += 100 + 10 * dot;
+        break;
+      }
+    }
+  }
+  emit(script, "%.3f end", t + 3000);
+  return script;
+}
+
+bool parseScriptText(Script& script, const std::string& text) {
+  scriptClear(script);
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('\n', start);
+    if (end == std::string::npos) end = text.size();
+    if (!scriptParseLine(script, text.substr(start, end - start).c_str())) return false;
+    start = end + 1;
+  }
+  scriptFinish(script);
+  return true;
+}
+
+// =========================================================================
+// EXECUTION
+// =========================================================================
+
+Event recentEvents[RECENT_EVENTS];
+unsigned long recentCount = 0;
+Event watchedRecent[2][RECENT_EVENTS];
+unsigned long watchedRecentCount[2] = { 0, 0 };
+
+uint64_t hostNanos() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * @brief Boots the core and runs the script pass by pass, recording the
+ *        cost of every pass. The inputs before the two watched passes
+ *        (-1 = none) are kept for --replay.
+ */
+void runScript(const Script& script, PassTrace& trace, long watch0, long watch1) {
+  uint64_t carry = 0;
+  size_t next = 0;
+  char buffer[256];
+
+  halNativeReset();
+  setup();
+  recentCount = 0;
+
+  for (unsigned long pass = 0; halNativeTime() < script.endTime; pass++) {
+    uint64_t now = halNativeTime();
+    for (; next < script.events.size() && script.events[next].time <= now; next++) {
+      scriptApply(script.events[next]);
+      recentEvents[recentCount++ % RECENT_EVENTS] = script.events[next];
+    }
+    if ((long)pass == watch0 || (long)pass == watch1) {
+      int slot = ((long)pass == watch0) ? 0 : 1;
+      watchedRecentCount[slot] = recentCount;
+      memcpy(watchedRecent[slot], recentEvents, sizeof(recentEvents));
+    }
+
+    uint64_t before = halNativeCycles();
+    uint64_t started = hostNanos();
+    loop();
+    uint64_t elapsed = hostNanos() - started;
+    uint64_t used = halNativeCycles() - before;
+    trace.cycles.push_back((uint32_t)used);
+    trace.nanos.push_back(elapsed > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)elapsed);
+    trace.times.push_back(now);
+    while (halNativeTakeOutput(buffer, sizeof(buffer)) > 0) {
+    }
+
+    carry += (used + coreCycles) * 1000000ULL;
+    unsigned long micros = (unsigned long)(carry / F_CPU_HZ);
+    carry -= (uint64_t)micros * F_CPU_HZ;
+    if (micros > 0) halNativeAdvance(micros);
+  }
+}
+
+/**
+ * @brief Takes size bytes off the front of a packed child result.
+ */
+bool unpack(const char*& bytes, size_t& left, void* data, size_t size) {
+  if (size > left) return false;
+  memcpy(data, bytes, size);
+  bytes += size;
+  left -= size;
+  return true;
+}
+
+struct ChildRun {
+  const Script* script;
+  bool first;
+};
+
+/**
+ * @brief Child side of runChild(): runs the script and packs the pass
+ *        count and host times, plus the cycles and pass times on the
+ *        first run.
+ */
+void runChildScript(const void* arg, std::string* result) {
+  const ChildRun& run = *(const ChildRun*)arg;
+  PassTrace own;
+  runScript(*run.script, own, -1, -1);
+  uint64_t count = own.nanos.size();
+  result->append((const char*)&count, sizeof(count));
+  result->append((const char*)own.nanos.data(), count * sizeof(uint32_t));
+  if (run.first) {
+    result->append((const char*)own.cycles.data(), count * sizeof(uint32_t));
+    result->append((const char*)own.times.data(), count * sizeof(uint64_t));
+  }
+}
+
+/**
+ * @brief Runs a script once in a child process (runIsolated()), so a
+ *        crash is reported, not fatal. The first run returns the whole
+ *        trace, later ones only host times.
+ */
+bool runChild(const Script& script, PassTrace& trace, bool first) {
+  ChildRun run = { &script, first };
+  std::string packed;
+  if (!runIsolated(runChildScript, &run, &packed)) return false;
+  const char* bytes = packed.data();
+  size_t left = packed.size();
+  uint64_t count = 0;
+  if (!unpack(bytes, left, &count, sizeof(count))) return false;
+  if (!first && count != trace.nanos.size()) return false;
+  std::vector<uint32_t> nanos(count);
+  bool ok = unpack(bytes, left, nanos.data(), count * sizeof(uint32_t));
+  if (ok && first) {
+    trace.cycles.resize(count);
+    trace.times.resize(count);
+    ok = unpack(bytes, left, trace.cycles.data(), count * sizeof(uint32_t)) &&
+         unpack(bytes, left, trace.times.data(), count * sizeof(uint64_t));
+  }
+  if (!ok) return false;
+  if (first) {
+    trace.nanos.swap(nanos);
+  } else {
+    for (size_t i = 0; i < count; i++) {
+      if (nanos[i] < trace.nanos[i]) trace.nanos[i] = nanos[i];
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Runs a script --repeats times and returns its worst passes.
+ */
+PassResult runIsolated(const Script& script) {
+  PassResult result = { 0, 0, 0, 0, 0, 0, false };
+  PassTrace trace;
+  for (unsigned long run = 0; run < repeats; run++) {
+    if (!runChild(script, trace, run == 0)) {
+      result.crashed = true;
+      return result;
+    }
+  }
+  for (size_t pass = 0; pass < trace.nanos.size(); pass++) {
+    if (trace.cycles[pass] > result.cycles) {
+      result.cycles = trace.cycles[pass];
+      result.cyclesPass = pass;
+      result.cyclesTime = trace.times[pass];
+    }
+    if (trace.nanos[pass] > result.nanos) {
+      result.nanos = trace.nanos[pass];
+      result.nanosPass = pass;
+      result.nanosTime = trace.times[pass];
+    }
+  }
+  return result;
+}
+
+void printEvent(const Event& event) {
+  double ms = event.time / 1000.0;
+  if (event.type == EV_KEYS) {
+    uint8_t keys = (uint8_t)event.value;
+    printf("  %.3f keys%s%s%s%s\n", ms, keys ? "" : " none", (keys & KEY_DOT) ? " dot" : "",
+           (keys & KEY_DASH) ? " dash" : "", (keys & KEY_STRAIGHT) ? " straight" : "");
+  } else if (event.type == EV_POT) {
+    printf("  %.3f pot %d\n", ms, event.value);
+  } else if (event.type == EV_RX) {
+    printf("  %.3f rx 0x%02X %c\n", ms, event.value, (event.value >= ' ' && event.value <= '~') ? event.value : '.');
+  }
+}
+
+void printRecent(int slot) {
+  unsigned long first = watchedRecentCount[slot] > RECENT_EVENTS ? watchedRecentCount[slot] - RECENT_EVENTS : 0;
+  for (unsigned long i = first; i < watchedRecentCount[slot]; i++) printEvent(watchedRecent[slot][i % RECENT_EVENTS]);
+}
+
+/**
+ * @brief Replays a script and lists the inputs before its worst passes.
+ */
+int replay(const char* path) {
+  Script script;
+  scriptClear(script);
+  if (!scriptLoad(script, path)) return 2;
+  PassResult worst = runIsolated(script);
+  if (worst.crashed) {
+    fprintf(stderr, "%s crashed\n", path);
+    return 1;
+  }
+  printf("{\"bench\":\"wcet_replay\",\"ns\":%llu,\"ns_pass\":%lu,\"ns_time_us\":%llu,"
+         "\"cycles\":%llu,\"cycles_pass\":%lu,\"cycles_time_us\":%llu}\n",
+         (unsigned long long)worst.nanos, worst.nanosPass, (unsigned long long)worst.nanosTime,
+         (unsigned long long)worst.cycles, worst.cyclesPass, (unsigned long long)worst.cyclesTime);
+  PassTrace trace;
+  runScript(script, trace, (long)worst.nanosPass, (long)worst.cyclesPass);
+  printf("inputs before the worst pass in host time:\n");
+  printRecent(0);
+  printf("inputs before the worst pass in HAL cycles:\n");
+  printRecent(1);
+  return 0;
+}
+
+// =========================================================================
+// MAIN
+// =========================================================================
+
+int main(int argc, char** argv) {
+  unsigned long trials = 200;
+  unsigned long seed = 1;
+  unsigned long limit = 0;
+  const char* outputPath = NULL;
+  const char* replayPath = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--trials") == 0 && i + 1 < argc) {
+      trials = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+      repeats = strtoul(argv[++i], NULL, 10);
+      if (repeats == 0) repeats = 1;
+    } else if (strcmp(argv[i], "--core-cycles") == 0 && i + 1 < argc) {
+      coreCycles = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+      limit = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outputPath = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replayPath = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--trials N] [--seed S] [--repeats N] [--core-cycles N]\n"
+                      "          [--limit CYCLES] [-o worst.txt]\n"
+                      "       %s --replay script\n", argv[0], argv[0]);
+      return 2;
+    }
+  }
+  if (replayPath != NULL) return replay(replayPath);
+
+  PassResult worst = { 0, 0, 0, 0, 0, 0, false };
+  std::string worstScript;
+  unsigned long worstTrial = 0;
+  uint64_t worstCycles = 0;
+  unsigned long worstCyclesTrial = 0;
+  unsigned long crashes = 0;
+
+  for (unsigned long trial = 0; trial < trials; trial++) {
+    std::string text = generateScript(seed + trial);
+    Script script;
+    if (!parseScriptText(script, text)) {
+      fprintf(stderr, "generated script %lu does not parse\n", trial);
+      return 2;
+    }
+    PassResult result = runIsolated(script);
+    if (result.crashed) {
+      crashes++;
+      fprintf(stderr, "trial %lu (seed %lu) crashed\n", trial, seed + trial);
+    }
+    if ((result.crashed && !worst.crashed) || (result.crashed == worst.crashed && result.nanos > worst.nanos)) {
+      worst = result;
+      worstScript = text;
+      worstTrial = trial;
+    }
+    if (result.cycles > worstCycles) {
+      worstCycles = result.cycles;
+      worstCyclesTrial = trial;
+    }
+  }
+
+  printf("{\"bench\":\"wcet\",\"trials\":%lu,\"seed\":%lu,\"repeats\":%lu,\"core_cycles\":%lu,\"crashes\":%lu,"
+         "\"worst_ns\":%llu,\"worst_trial\":%lu,\"worst_pass\":%lu,\"worst_time_us\":%llu,"
+         "\"worst_cycles\":%llu,\"worst_cycles_trial\":%lu}\n",
+         trials, seed, repeats, coreCycles, crashes, (unsigned long long)worst.nanos, worstTrial, worst.nanosPass,
+         (unsigned long long)worst.nanosTime, (unsigned long long)worstCycles, worstCyclesTrial);
+
+  if (outputPath != NULL) {
+    FILE* output = fopen(outputPath, "w");
+    if (output == NULL) {
+      fprintf(stderr, "cannot write %s\n", outputPath);
+      return 2;
+    }
+    fputs(worstScript.c_str(), output);
+    fclose(output);
+  }
+
+  if (crashes > 0) return 1;
+  if (limit > 0 && worstCycles > limit) {
+    fprintf(stderr, "worst pass %llu cycles exceeds the limit of %lu\n", (unsigned long long)worstCycles, limit);
+    return 1;
+  }
+  return 0;
+}
+
+#endif // !ARDUINO
@@ -0,0 +1,309 @@
+// WinKeyer host protocol loopback check on the native HAL.
+// Boots the core, switches it to the WinKeyer protocol with the "WK"
+// command and then plays the host: each step sends protocol bytes into
+// the receive interrupt (serialRxByte(), as the UART would), runs loop()
+// for a while and compares the bytes sent back and the elements keyed
+// with what a WinKeyer 2 host expects (see WINKEYER HOST PROTOCOL in
+// "cw practice.cpp"). Status bytes are 0xC0 | BUSY (0x04) / BREAKIN (0x02)
+// / XOFF (0x01) and arrive whenever the status changes. Prints one line
+// per step; the exit status is 1 on any mismatch.
+//
+// With --pty the host talks to a pseudo-terminal instead, the way a
+// logging program opens the serial port: a thread runs loop() on the
+// slave side, moving bytes between it and the core, while the steps in
+// PTY_STEPS are written to the master and the replies read back with a
+// real-time timeout. Only bytes are checked there; virtual time runs as
+// fast as the thread can go, so element timing stays with the direct run.
+//
+// Built as cwwinkeyer by CMakeLists.txt and run by ctest, once each way;
+// on its own:
+//   build/cwwinkeyer [--pty]
+
+#if !defined(ARDUINO)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include "hal.h"
+#include "host_harness.h"
+
+// =========================================================================
+// STEPS
+// =========================================================================
+const unsigned long LOOP_MICROS = 20;    // Virtual cost of one loop() pass
+
+struct WinkeyerStep {
+  const char* name;
+  const char* send;       // Host bytes, as hex
+  unsigned long runMs;    // loop() time after the bytes arrive
+  const char* reply;      // Expected device bytes, as hex
+  const char* elements;   // Expected keyed elements ('.' / '-')
+  unsigned long dotMs;    // Dot length the elements must have, in ms; 0 = not checked
+};
+
+const WinkeyerStep STEPS[] = {
+  // The first step switches over with the text command, answered at the
+  // old rate; all later steps speak the binary protocol
+  { "WK command",         "574B0D",         200,  "4F4B20574B0D0A",  "",       0 },
+  { "host open",          "0002",           50,   "17",              "",       0 },
+  { "echo test",          "000455",         50,   "55",              "",       0 },
+  { "status request",     "15",             50,   "C0",              "",       0 },
+  { "set speed 30",       "021E",           50,   "",                "",       0 },
+  // "EE" is keyed at 30 WPM and echoed, framed by BUSY on and off
+  { "text",               "4545",           1000, "C4 45 45 C0",       "..",     40 },
+  // Lower case is sent as upper case
+  { "lower case text",    "65",             1000, "C4 45 C0",          ".",      40 },
+  // The last "T" is taken back before it starts
+  { "backspace",          "5445535408",     2000, "C4 54 45 53 C0",     "-....",  40 },
+  // Clearing the buffer stops the first dot short and echoes nothing
+  { "clear buffer",       "4545454545",     20,   "C4",              "",       0 },
+  { "",                   "0A",             500,  "C0",              ".",      0 },
+  // Punctuation, and a byte without Morse code that is skipped
+  { "punctuation",        "3F2F",           2000, "C4 3F 2F C0",       "..--..-..-.", 40 },
+  { "no Morse code",      "23",             500,  "",                "",       0 },
+  // Back on the pot (at 0: 5 WPM), reported to the host as it changes
+  { "pot speed",          "0200",           50,   "80",              "",       0 },
+  { "read pot",           "07",             50,   "80",              "",       0 },
+  { "host close",         "0003",           50,   "",                "",       0 },
+  // A closed host gets no status bytes
+  { "text, host closed",  "45",             1000, "45",              ".",      240 },
+};
+const int STEP_COUNT = sizeof(STEPS) / sizeof(STEPS[0]);
+
+// The steps whose replies do not depend on when the bytes arrive
+const WinkeyerStep PTY_STEPS[] = {
+  { "WK command",         "574B0D",         0,    "4F4B20574B0D0A",  "",       0 },
+  { "host open",          "0002",           0,    "17",              "",       0 },
+  { "echo test",          "000455",         0,    "55",              "",       0 },
+  { "status request",     "15",             0,    "C0",              "",       0 },
+  { "set speed 30",       "021E",           0,    "",                "",       0 },
+  { "text",               "4545",           0,    "C4 45 45 C0",     "",       0 },
+  { "punctuation",        "3F2F",           0,    "C4 3F 2F C0",     "",       0 },
+  { "no Morse code",      "23",             0,    "",                "",       0 },
+  { "host close",         "0003",           0,    "",                "",       0 },
+};
+const int PTY_STEP_COUNT = sizeof(PTY_STEPS) / sizeof(PTY_STEPS[0]);
+const int PTY_REPLY_MS = 2000;   // Real time a reply may take to arrive
+const int PTY_QUIET_MS = 100;    // Real time without a byte that ends a reply
+
+// =========================================================================
+// EXECUTION
+// =========================================================================
+
+std::string hexBytes(const std::string& bytes) {
+  std::string hex;
+  char digits[4];
+  for (size_t i = 0; i < bytes.size(); i++) {
+    snprintf(digits, sizeof(digits), "%02X", (uint8_t)bytes[i]);
+    hex += digits;
+  }
+  return hex;
+}
+
+/**
+ * @brief Hex string to bytes; spaces are only there for readability.
+ */
+std::string parseHex(const char* hex) {
+  std::string bytes;
+  unsigned int value;
+  int consumed;
+  while (*hex) {
+    if (*hex == ' ') {
+      hex++;
+    } else if (sscanf(hex, "%2x%n", &value, &consumed) == 1 && consumed == 2) {
+      bytes += (char)value;
+      hex += 2;
+    } else {
+      break;
+    }
+  }
+  return bytes;
+}
+
+struct StepResult {
+  std::string reply;
+  std::string elements;
+  unsigned long worstError;  // Largest element length error, in us
+};
+
+bool keyOn = false;
+uint64_t keyDownTime = 0;
+unsigned long dotMicros = 0;  // Dot length the keyer is expected to use
+
+/**
+ * @brief Delivers the host bytes to the receive interrupt and runs the
+ *        core, collecting what it sends back and keys.
+ */
+StepResult runStep(const WinkeyerStep& step) {
+  StepResult result = { "", "", 0 };
+  if (step.dotMs > 0) dotMicros = step.dotMs * 1000UL;
+  std::string bytes = parseHex(step.send);
+  for (size_t i = 0; i < bytes.size(); i++) serialRxByte((uint8_t)bytes[i], false);
+
+  uint64_t end = halNativeTime() + step.runMs * 1000ULL;
+  while (halNativeTime() < end) {
+    uint64_t now = halNativeTime();
+    loop();
+    result.reply += drainOutput();
+    if (halNativeKeyOutput() != keyOn) {
+      keyOn = !keyOn;
+      if (keyOn) {
+        keyDownTime = now;
+      } else {
+        unsigned long held = (unsigned long)(now - keyDownTime);
+        bool dash = held >= 2 * dotMicros;
+        long error = (long)held - (long)(dash ? 3 * dotMicros : dotMicros);
+        if (error < 0) error = -error;
+        if ((unsigned long)error > result.worstError) result.worstError = error;
+        result.elements += dash ? '-' : '.';
+      }
+    }
+    halNativeAdvance(LOOP_MICROS);
+  }
+  return result;
+}
+
+// =========================================================================
+// PSEUDO-TERMINAL
+// =========================================================================
+
+std::atomic<bool> deviceRunning(false);
+
+/**
+ * @brief The device side: loop() with the pty slave as its serial port,
+ *        until deviceRunning is cleared.
+ */
+void runDevice(int slave) {
+  while (deviceRunning) {
+    uint8_t buffer[64];
+    ssize_t got = read(slave, buffer, sizeof(buffer));
+    for (ssize_t i = 0; i < got; i++) serialRxByte(buffer[i], false);
+    loop();
+    std::string output = drainOutput();
+    for (size_t sent = 0; sent < output.size();) {
+      ssize_t written = write(slave, output.data() + sent, output.size() - sent);
+      if (written > 0) sent += written;
+    }
+    halNativeAdvance(LOOP_MICROS);
+  }
+}
+
+/**
+ * @brief Reads from the master until expected bytes have arrived and the
+ *        line has been quiet for PTY_QUIET_MS, or PTY_REPLY_MS has passed.
+ */
+std::string readReply(int master, size_t expected) {
+  std::string reply;
+  int waited = 0;
+  while (waited < PTY_REPLY_MS) {
+    struct pollfd ready = { master, POLLIN, 0 };
+    int timeout = (reply.size() >= expected) ? PTY_QUIET_MS : 10;
+    if (poll(&ready, 1, timeout) <= 0) {
+      if (reply.size() >= expected) break;
+      waited += timeout;
+      continue;
+    }
+    char buffer[64];
+    ssize_t got = read(master, buffer, sizeof(buffer));
+    if (got > 0) reply.append(buffer, got);
+  }
+  return reply;
+}
+
+/**
+ * @brief Plays PTY_STEPS through a pseudo-terminal; returns the failures,
+ *        or -1 if the pty could not be set up.
+ */
+int runPtySession() {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("posix_openpt");
+    return -1;
+  }
+  int slave = open(ptsname(master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (slave < 0) {
+    perror("open pty slave");
+    close(master);
+    return -1;
+  }
+  // Raw bytes both ways, as on a serial port
+  struct termios settings;
+  tcgetattr(slave, &settings);
+  cfmakeraw(&settings);
+  tcsetattr(slave, TCSANOW, &settings);
+
+  halNativeReset();
+  setup();
+  drainOutput();
+  deviceRunning = true;
+  std::thread device(runDevice, slave);
+  readReply(master, 0); // Nothing is sent before the host speaks
+
+  int failures = 0;
+  for (int i = 0; i < PTY_STEP_COUNT; i++) {
+    const WinkeyerStep& step = PTY_STEPS[i];
+    std::string bytes = parseHex(step.send);
+    if (write(master, bytes.data(), bytes.size()) != (ssize_t)bytes.size()) perror("write pty");
+    std::string expected = hexBytes(parseHex(step.reply));
+    std::string got = hexBytes(readReply(master, expected.size() / 2));
+    bool pass = got == expected;
+    if (!pass) failures++;
+    printf("%s pty %-14s reply %-16s", pass ? "PASS" : "FAIL", step.name, got.c_str());
+    if (!pass) printf(" (expected %s)", expected.c_str());
+    printf("\n");
+  }
+
+  deviceRunning = false;
+  device.join();
+  close(slave);
+  close(master);
+  printf("%d of %d pty steps failed\n", failures, PTY_STEP_COUNT);
+  return failures;
+}
+
+// =========================================================================
+// MAIN
+// =========================================================================
+
+int main(int argc, char** argv) {
+  if (argc == 2 && strcmp(argv[1], "--pty") == 0) {
+    int failures = runPtySession();
+    return failures != 0 ? 1 : 0;
+  }
+  if (argc != 1) {
+    fprintf(stderr, "usage: %s [--pty]\n", argv[0]);
+    return 2;
+  }
+
+  halNativeReset();
+  setup();
+  drainOutput();
+
+  int failures = 0;
+  for (int i = 0; i < STEP_COUNT; i++) {
+    const WinkeyerStep& step = STEPS[i];
+    StepResult result = runStep(step);
+    std::string expected = hexBytes(parseHex(step.reply));
+    std::string got = hexBytes(result.reply);
+    bool pass = got == expected && result.elements == step.elements;
+    // Element lengths are checked to within one loop() pass
+    if (step.dotMs > 0 && result.worstError > LOOP_MICROS) pass = false;
+    if (!pass) failures++;
+    printf("%s %-18s reply %-16s keyed %-6s", pass ? "PASS" : "FAIL", step.name[0] ? step.name : "...",
+           got.c_str(), result.elements.c_str());
+    if (step.dotMs > 0) printf(" at %lu ms dots, error %lu us", step.dotMs, result.worstError);
+    if (!pass) printf(" (expected %s, %s)", expected.c_str(), step.elements);
+    printf("\n");
+  }
+  printf("%d of %d steps failed\n", failures, STEP_COUNT);
+  return failures ? 1 : 0;
+}
+
+#endif // !ARDUINO